@@ -24,21 +24,59 @@ enum taa_asset_state_e
     taa_ASSET_ERROR
 };
 
+/**
+ * @brief urgency classes for file requests
+ * @details Each class has a latency budget that is added to the time of
+ *          submission to form the request deadline. The storage threads
+ *          service queued requests in deadline order, so requests in a lower
+ *          class are still serviced once their deadline has passed.
+ */
+enum taa_asset_priority_e
+{
+    // needed immediately; the requester will wait for it
+    taa_ASSET_PRIORITY_BLOCKING,
+    // needed for content that is currently visible
+    taa_ASSET_PRIORITY_VISIBLE,
+    // needed soon
+    taa_ASSET_PRIORITY_NORMAL,
+    // prefetch that may never be used
+    taa_ASSET_PRIORITY_SPECULATIVE
+};
+
+/**
+ * @brief outcome of a request delivered through a completion queue
+ */
+enum taa_asset_completion_status_e
+{
+    // the file was loaded successfully
+    taa_ASSET_COMPLETION_OK,
+    // the file could not be read; the data pointer is NULL
+    taa_ASSET_COMPLETION_ERROR,
+    // the request was cancelled with its group; the data pointer is NULL
+    taa_ASSET_COMPLETION_CANCELLED
+};
+
 //****************************************************************************
 // typedefs
 
 typedef enum taa_asset_state_e taa_asset_state;
+typedef enum taa_asset_priority_e taa_asset_priority;
+typedef enum taa_asset_completion_status_e taa_asset_completion_status;
 
 // data types
 
+typedef struct taa_asset_completion_s taa_asset_completion;
 typedef struct taa_asset_file_s taa_asset_file;
 typedef struct taa_asset_file_request_s taa_asset_file_request;
+typedef struct taa_asset_file_request_desc_s taa_asset_file_request_desc;
 typedef struct taa_asset_group_s taa_asset_group;
+typedef struct taa_asset_request_handle_s taa_asset_request_handle;
 typedef union taa_asset_key_u taa_asset_key;
 
 // opaque types
 
 typedef struct taa_asset_s taa_asset;
+typedef struct taa_asset_completion_queue_s taa_asset_completion_queue;
 typedef struct taa_asset_storage_s taa_asset_storage;
 
 /**
@@ -48,7 +86,8 @@ typedef struct taa_asset_storage_s taa_asset_storage;
  *          buffer into the native in-memory representation. The data buffer
  *          is temporary and will expire after this function returns.
  * @param buf the file data loaded from storage
- * @param size the size of the file data in bytes
+ * @param size the size of the file data in bytes, which is the length of
+ *        the requested range
  * @param userdata the user context data that was provided when the request
  *        was made.
  */
@@ -57,12 +96,47 @@ typedef void (*taa_asset_parse_func)(
     size_t size,
     void* userdata);
 
+/**
+ * @brief function pointer called when a request is cancelled with its group
+ * @details When a group is cancelled, this function is pushed to the work
+ *          queue of each request in place of the parse function so that the
+ *          owner may release any state associated with the request.
+ * @param userdata the user context data that was provided when the request
+ *        was made.
+ */
+typedef void (*taa_asset_cancel_func)(
+    void* userdata);
+
+/**
+ * @brief function pointer called when loaded data is no longer needed
+ * @details Storage plugins provide this function when completing a request
+ *          so that they may reclaim the memory containing the file data.
+ * @param releasedata the context data provided with the completed request
+ */
+typedef void (*taa_asset_release_func)(
+    void* releasedata);
+
 /**
  * @brief function pointer responsible for reading data from storage
  * @details This function is implemented by storage plugins to read the
  *          requested files from persistent storage. It will be executed on
- *          the storage thread and should block until all the requests have
- *           been fulfilled.
+ *          a storage thread and should block until all the requests have
+ *          been fulfilled. When the storage instance was created with more
+ *          than one thread, it may be called concurrently for different
+ *          request lists, including lists that belong to the same group.
+ *          Only the range of each file given by the offset and length of its
+ *          request is to be loaded. taa_asset_complete_request must be
+ *          called exactly once for every request in the list; the request
+ *          may not be accessed afterward.
+ *          When none of the queued requests of a group are due, the list
+ *          holds a large window of them, so the plugin may order many
+ *          requests by where the data is stored. Otherwise it holds a small
+ *          batch of the most urgent requests.
+ *          A request may be completed after the load function returns, such
+ *          as when its data must be decoded on another thread first.
+ *          Plugins that keep many reads in flight may take further requests
+ *          for the group with taa_asset_refill_requests rather than
+ *          returning and waiting for the next list.
  * @param storage the storage instance that contains the requested files
  * @param requests a linked list of file requests to be fulfilled
  */
@@ -82,15 +156,72 @@ struct taa_asset_file_s
     uintptr_t handle;
 };
 
+/**
+ * @brief record of a finished request retrieved from a completion queue
+ * @details The data remains valid until the record is released with
+ *          taa_asset_release_completion.
+ */
+struct taa_asset_completion_s
+{
+    taa_asset_file* file;
+    const void* data;
+    size_t size;
+    taa_asset_completion_status status;
+    void* userdata;
+    // the request that produced the record; managed by the storage instance
+    taa_asset_file_request* request;
+};
+
 struct taa_asset_file_request_s
 {
     taa_asset_file* file;
+    // the handle of the file when the request was made. storage plugins
+    // should use it instead of file->handle, because the file table of a
+    // group may be updated while the request is in flight.
+    uintptr_t handle;
+    // the range of bytes to load, which always lies within the file
+    uint32_t offset;
+    uint32_t length;
+    taa_asset_group* group;
+    taa_asset_completion_queue* completionqueue;
     taa_workqueue* workqueue;
     taa_asset_parse_func parsefunc;
     void* userdata;
+    taa_asset_priority priority;
+    // the remaining fields are managed by the storage instance
+    taa_asset_storage* storage;
+    taa_asset_cancel_func cancelfunc;
+    const void* data;
+    size_t size;
+    taa_asset_release_func releasefunc;
+    void* releasedata;
+    int32_t state;
+    uint32_t submitted;
+    uint32_t deadline;
     taa_asset_file_request* next;
 };
 
+/**
+ * @brief describes one file request when submitting requests in bulk
+ */
+struct taa_asset_file_request_desc_s
+{
+    taa_asset_group* group;
+    taa_asset_file* file;
+    // the range of bytes to load. a length of zero loads everything from
+    // the offset to the end of the file, so a zeroed range loads the whole
+    // file. ranges that extend past the end of the file are truncated.
+    uint32_t offset;
+    uint32_t length;
+    // if not NULL, the request is delivered to this completion queue and
+    // the workqueue and parse function are ignored
+    taa_asset_completion_queue* completionqueue;
+    taa_workqueue* workqueue;
+    taa_asset_parse_func parsefunc;
+    void* userdata;
+    taa_asset_priority priority;
+};
+
 struct taa_asset_group_s
 {
     const char* name;
@@ -100,6 +231,17 @@ struct taa_asset_group_s
     taa_asset_load_func loadfunc;
 };
 
+/**
+ * @brief identifies a file request after it has been submitted
+ * @details The handle remains safe to use after the request has completed;
+ *          operations on a completed request have no effect.
+ */
+struct taa_asset_request_handle_s
+{
+    taa_asset_file_request* request;
+    uint32_t serial;
+};
+
 union taa_asset_key_u
 {
     struct
@@ -117,28 +259,283 @@ taa_ASSET_LINKAGE taa_asset_key taa_asset_gen_key(
     const char* group,
     const char* file);
 
+/**
+ * @brief generates the key of a file from its name
+ * @details The key is a hash of the name without its directory or
+ *          extension. Ascii letters are hashed as lower case, so names that
+ *          differ only in case have the same key. Names are hashed eight
+ *          bytes at a time without being copied. The same key is given by
+ *          taa_ASSET_FILEKEY at compile time.
+ */
 taa_ASSET_LINKAGE uint32_t taa_asset_gen_filekey(
     const char* name);
 
+/**
+ * @brief generates a 64 bit key of a file from its name
+ * @details The 32 bit file key is the upper half of this key, and the
+ *          lower half is a hash of the name with different constants.
+ *          Storage groups and asset maps identify files by
+ *          the 32 bit key, so this is for applications that keep their own
+ *          tables of files and want keys that are much less likely to
+ *          collide.
+ */
+taa_ASSET_LINKAGE uint64_t taa_asset_gen_filekey64(
+    const char* name);
+
+/**
+ * @brief generates the key of a group from its name
+ * @details The whole name is hashed, with ascii letters as lower case.
+ *          The same key is given by taa_ASSET_GROUPKEY at compile time.
+ */
 taa_ASSET_LINKAGE uint32_t taa_asset_gen_groupkey(
     const char* name);
 
+/**
+ * @brief generates the key of a file type from an extension or file name
+ * @details Only the part of the name after the last period is hashed, with
+ *          ascii letters as lower case. The same key is given by
+ *          taa_ASSET_TYPEKEY at compile time.
+ */
 taa_ASSET_LINKAGE uint32_t taa_asset_gen_typekey(
     const char* ext);
 
+/**
+ * @brief returns true if two file names name the same file
+ * @details Names that differ only in their directory, their extension, or
+ *          the case of their ascii letters name the same file, and are
+ *          expected to have the same file key. Two names with the same key
+ *          that do not name the same file are a collision.
+ */
+taa_ASSET_LINKAGE int taa_asset_same_file_stem(
+    const char* name0,
+    const char* name1);
+
+/**
+ * @brief returns true if two extensions or file names have the same
+ *        extension, ignoring the case of ascii letters
+ */
+taa_ASSET_LINKAGE int taa_asset_same_file_ext(
+    const char* ext0,
+    const char* ext1);
+
+//****************************************************************************
+// compile time key generation
+
+// the constants of the key hash. each 32 bit chunk of a name is multiplied
+// by the key constant for its position, and the key is the upper half of
+// the sum of the products. the chunks after the first 16 reuse the
+// constants, offset by the round constant once for every 16 chunks.
+#define taa_ASSET_HASH_INIT 0x9eeb0e7302d85ae7ULL
+#define taa_ASSET_HASH_ROUND 0xb35c90e27a4e9b87ULL
+#define taa_ASSET_HASH_K0 0xc1b71250abd67af3ULL
+#define taa_ASSET_HASH_K1 0x921ddcee482e64bbULL
+#define taa_ASSET_HASH_K2 0x5d79d858e4f3e361ULL
+#define taa_ASSET_HASH_K3 0x49210d3ad807809fULL
+#define taa_ASSET_HASH_K4 0xbc61cfe6ec996ad7ULL
+#define taa_ASSET_HASH_K5 0x56cc483ca8853cadULL
+#define taa_ASSET_HASH_K6 0xbe25d3103a2a2a0dULL
+#define taa_ASSET_HASH_K7 0x7029d2ba40897531ULL
+#define taa_ASSET_HASH_K8 0x20936633af20b407ULL
+#define taa_ASSET_HASH_K9 0x9835db9a8a6879a5ULL
+#define taa_ASSET_HASH_K10 0xa144e15198a2d8d5ULL
+#define taa_ASSET_HASH_K11 0xb78e5bd3e66bb64bULL
+#define taa_ASSET_HASH_K12 0xa3df587c3fb363f5ULL
+#define taa_ASSET_HASH_K13 0x9499e91eb1bb4449ULL
+#define taa_ASSET_HASH_K14 0x8e4cd6ab6a884afbULL
+#define taa_ASSET_HASH_K15 0x57c35996fac13f81ULL
+
+// the longest name the compile time key macros accept in C
+#define taa_ASSET_HASH_MAX_LITERAL 64
+
+#ifdef __cplusplus
+
+#include <taa/path.h>
+
+// the key generation functions as constant expressions. they are written
+// as single return statements so that they are valid in C++11.
+
+static constexpr uint64_t taa_asset_const_hash_keys[16] =
+{
+    taa_ASSET_HASH_K0, taa_ASSET_HASH_K1, taa_ASSET_HASH_K2,
+    taa_ASSET_HASH_K3, taa_ASSET_HASH_K4, taa_ASSET_HASH_K5,
+    taa_ASSET_HASH_K6, taa_ASSET_HASH_K7, taa_ASSET_HASH_K8,
+    taa_ASSET_HASH_K9, taa_ASSET_HASH_K10, taa_ASSET_HASH_K11,
+    taa_ASSET_HASH_K12, taa_ASSET_HASH_K13, taa_ASSET_HASH_K14,
+    taa_ASSET_HASH_K15
+};
+
+constexpr uint64_t taa_asset_const_hash_char(
+    const char* s,
+    size_t len,
+    size_t i)
+{
+    return (i >= len) ? 0 :
+        (s[i] >= 'A' && s[i] <= 'Z') ?
+            (uint64_t) (unsigned char) s[i] | 0x20 :
+            (uint64_t) (unsigned char) s[i];
+}
+
+constexpr uint64_t taa_asset_const_hash_sum(
+    const char* s,
+    size_t len,
+    size_t chunk,
+    uint64_t acc)
+{
+    return (chunk*4 >= len) ? acc : taa_asset_const_hash_sum(
+        s,
+        len,
+        chunk + 1,
+        acc +
+            (taa_asset_const_hash_char(s, len, chunk*4) |
+             (taa_asset_const_hash_char(s, len, chunk*4 + 1) << 8) |
+             (taa_asset_const_hash_char(s, len, chunk*4 + 2) << 16) |
+             (taa_asset_const_hash_char(s, len, chunk*4 + 3) << 24)) *
+            (taa_asset_const_hash_keys[chunk & 15] +
+             (chunk >> 4) * taa_ASSET_HASH_ROUND));
+}
+
+constexpr uint32_t taa_asset_const_hash(
+    const char* s,
+    size_t len)
+{
+    return (uint32_t) (
+        taa_asset_const_hash_sum(s, len, 0, taa_ASSET_HASH_INIT) >> 32);
+}
+
+// returns the length of a string up to a terminator or the specified char
+constexpr size_t taa_asset_const_span(
+    const char* s,
+    char c)
+{
+    return (*s == '\0' || *s == c) ? 0 : 1 + taa_asset_const_span(s + 1, c);
+}
+
+// returns the string following the last occurrence of a char, or the
+// whole string if it does not occur
+constexpr const char* taa_asset_const_after(
+    const char* s,
+    char c,
+    const char* result)
+{
+    return (*s == '\0') ? result :
+        taa_asset_const_after(s + 1, c, (*s == c) ? s + 1 : result);
+}
+
+constexpr uint32_t taa_asset_const_filekey(
+    const char* name)
+{
+    return taa_asset_const_hash(
+        taa_asset_const_after(name, taa_PATH_SLASH, name),
+        taa_asset_const_span(
+            taa_asset_const_after(name, taa_PATH_SLASH, name),
+            '.'));
+}
+
+constexpr uint32_t taa_asset_const_groupkey(
+    const char* name)
+{
+    return taa_asset_const_hash(name, taa_asset_const_span(name, '\0'));
+}
+
+constexpr uint32_t taa_asset_const_typekey(
+    const char* ext)
+{
+    return taa_asset_const_hash(
+        taa_asset_const_after(ext, '.', ext),
+        taa_asset_const_span(taa_asset_const_after(ext, '.', ext), '\0'));
+}
+
+constexpr taa_asset_key taa_asset_const_key(
+    const char* group,
+    const char* file)
+{
+    return taa_asset_key {
+        { taa_asset_const_groupkey(group), taa_asset_const_filekey(file) } };
+}
+
+#define taa_ASSET_HASH_LITERAL(s) taa_asset_const_hash(s, sizeof(s) - 1)
+
+#else
+
+// the C macros expand to an expression of every char of the literal up to
+// the maximum length, where the chars past the end of the literal read its
+// terminator. a longer literal fails to compile.
+#define taa_ASSET_HASH_CHAR(s, i) \
+    taa_ASSET_HASH_LOWER((uint64_t) (unsigned char) \
+        (s)[((i) < sizeof(s)) ? (i) : sizeof(s) - 1])
+#define taa_ASSET_HASH_LOWER(b) ((b) | (((uint64_t) ((b)-0x41 < 26)) << 5))
+#define taa_ASSET_HASH_TERM(s, i) \
+    ((taa_ASSET_HASH_CHAR(s, (i)*4) | \
+      (taa_ASSET_HASH_CHAR(s, (i)*4 + 1) << 8) | \
+      (taa_ASSET_HASH_CHAR(s, (i)*4 + 2) << 16) | \
+      (taa_ASSET_HASH_CHAR(s, (i)*4 + 3) << 24)) * taa_ASSET_HASH_K##i)
+#define taa_ASSET_HASH_LITERAL(s) \
+    ((uint32_t) ((taa_ASSET_HASH_INIT + \
+        taa_ASSET_HASH_TERM(s, 0) + taa_ASSET_HASH_TERM(s, 1) + \
+        taa_ASSET_HASH_TERM(s, 2) + taa_ASSET_HASH_TERM(s, 3) + \
+        taa_ASSET_HASH_TERM(s, 4) + taa_ASSET_HASH_TERM(s, 5) + \
+        taa_ASSET_HASH_TERM(s, 6) + taa_ASSET_HASH_TERM(s, 7) + \
+        taa_ASSET_HASH_TERM(s, 8) + taa_ASSET_HASH_TERM(s, 9) + \
+        taa_ASSET_HASH_TERM(s, 10) + taa_ASSET_HASH_TERM(s, 11) + \
+        taa_ASSET_HASH_TERM(s, 12) + taa_ASSET_HASH_TERM(s, 13) + \
+        taa_ASSET_HASH_TERM(s, 14) + taa_ASSET_HASH_TERM(s, 15) + \
+        0 * sizeof(char[ \
+            (sizeof(s) <= taa_ASSET_HASH_MAX_LITERAL + 1) ? 1 : -1])) \
+        >> 32))
+
+#endif
+
+/**
+ * @brief gives the key of a file from a string literal at compile time
+ * @details The literal is the name of the file without its directory or
+ *          extension, and the key is the same as the one generated by
+ *          taa_asset_gen_filekey. In C, the result may initialize static
+ *          variables and is folded by an optimizing compiler, but it is not
+ *          an integer constant expression, and the literal may be no longer
+ *          than taa_ASSET_HASH_MAX_LITERAL. Each use expands to an
+ *          expression of every char, so a header of constants written by
+ *          the assetkeys tool is better suited to many keys. In C++, the
+ *          result is a constant expression, and taa_asset_const_filekey
+ *          also accepts a name with a directory and extension.
+ */
+#define taa_ASSET_FILEKEY(stem) taa_ASSET_HASH_LITERAL("" stem)
+
+/**
+ * @brief gives the key of a group from a string literal at compile time
+ */
+#define taa_ASSET_GROUPKEY(name) taa_ASSET_HASH_LITERAL("" name)
+
+/**
+ * @brief gives the key of a file type from a string literal of an
+ *        extension, without its period, at compile time
+ */
+#define taa_ASSET_TYPEKEY(ext) taa_ASSET_HASH_LITERAL("" ext)
+
+/**
+ * @brief initializer of a taa_asset_key from string literals of a group
+ *        name and a file name without its directory or extension
+ */
+#define taa_ASSET_KEY_INIT(group, stem) \
+    { { taa_ASSET_GROUPKEY(group), taa_ASSET_FILEKEY(stem) } }
+
 //****************************************************************************
 // storage functions
 
 /**
- * @param groupcapacity The maximum number of groups that can be
+ * @param storagecapacity The maximum number of groups that can be
  *        actively requested at one time.
  * @param reqcapacity The maximum number of file instances that can be
- *        actively requested at one time.
+ *        actively requested at one time. May not exceed 65535.
+ * @param numthreads The number of storage threads to service requests.
+ *        Each thread loads a different group at a time, so there is no
+ *        benefit to using more threads than groups that will be requested
+ *        concurrently. Must be at least one.
  * @param storage_out out parameter that will be set to the storage handle
  */
 taa_ASSET_LINKAGE void taa_asset_create_storage(
     uint32_t storagecapacity,
     uint32_t reqcapacity,
+    uint32_t numthreads,
     taa_asset_storage** storage_out);
 
 taa_ASSET_LINKAGE void taa_asset_destroy_storage(
@@ -151,16 +548,191 @@ taa_ASSET_LINKAGE void taa_asset_destroy_storage(
  * @param wq the parse callback will be pushed to this workqueue
  * @param parsefunc callback function to call to parse the loaded file
  * @param userdata context data that will be provided to parse function
+ * @param priority the urgency class used to schedule the request
+ * @return handle that may be used to refer to the request while it is queued
  */
-taa_ASSET_LINKAGE void taa_asset_request_file(
+taa_ASSET_LINKAGE taa_asset_request_handle taa_asset_request_file(
     taa_asset_storage* storage,
     taa_asset_group* group,
     taa_asset_file* file,
     taa_workqueue* wq, 
     taa_asset_parse_func parsefunc,
-    void* userdata);
+    void* userdata,
+    taa_asset_priority priority);
+
+/**
+ * @brief requests a range of bytes from a file
+ * @details Behaves like taa_asset_request_file, but only the specified
+ *          range is loaded, so a parser may fetch a header or a single
+ *          level of an image without reading the entire file. The parse
+ *          function receives the data of the range.
+ * @param offset the offset of the first byte to load
+ * @param length the number of bytes to load, or zero to load through the
+ *        end of the file
+ */
+taa_ASSET_LINKAGE taa_asset_request_handle taa_asset_request_file_range(
+    taa_asset_storage* storage,
+    taa_asset_group* group,
+    taa_asset_file* file,
+    uint32_t offset,
+    uint32_t length,
+    taa_workqueue* wq,
+    taa_asset_parse_func parsefunc,
+    void* userdata,
+    taa_asset_priority priority);
+
+/**
+ * @brief submits an array of file requests at once
+ * @details Equivalent to calling taa_asset_request_file for each element,
+ *          but the request structs are reserved from the pool together, the
+ *          whole batch is published to the storage threads with a single
+ *          atomic operation, and at most one thread is woken.
+ * @param storage handle to the asset storage instance
+ * @param reqs array of request descriptions
+ * @param n number of elements in reqs
+ * @param handles_out optional array of n handles that will be set to the
+ *        handles of the submitted requests. May be NULL.
+ */
+taa_ASSET_LINKAGE void taa_asset_request_files(
+    taa_asset_storage* storage,
+    const taa_asset_file_request_desc* reqs,
+    uint32_t n,
+    taa_asset_request_handle* handles_out);
+
+/**
+ * @brief cancels a request whose data is no longer needed
+ * @details If the request is still queued, it is removed from the queue. If
+ *          its data is being read or is waiting to be parsed, the parse
+ *          function will not be called. Nothing is called in place of the
+ *          parse function; the caller is responsible for releasing any state
+ *          associated with the request when this function succeeds.
+ * @return nonzero if the request was cancelled before parsing began, zero if
+ *         the request has been parsed or is being parsed.
+ */
+taa_ASSET_LINKAGE int taa_asset_cancel_request(
+    taa_asset_storage* storage,
+    taa_asset_request_handle handle);
+
+/**
+ * @brief cancels every outstanding request for a group
+ * @details Intended for unloading a group. Requests that have not begun
+ *          parsing are discarded. If cancelfunc is not NULL, it is pushed to
+ *          the work queue of each discarded request in place of the parse
+ *          function. Requests submitted with a completion queue are instead
+ *          reported with a cancelled record.
+ */
+taa_ASSET_LINKAGE void taa_asset_cancel_group(
+    taa_asset_storage* storage,
+    taa_asset_group* group,
+    taa_asset_cancel_func cancelfunc);
+
+/**
+ * @brief moves a queued request into a more urgent priority class
+ * @details The new deadline is calculated from the time the request was
+ *          originally submitted. Requests cannot be lowered in priority.
+ * @return nonzero if the request was still queued, zero otherwise
+ */
+taa_ASSET_LINKAGE int taa_asset_raise_request_priority(
+    taa_asset_storage* storage,
+    taa_asset_request_handle handle,
+    taa_asset_priority priority);
 
 taa_ASSET_LINKAGE void taa_asset_stop_storage_thread(
     taa_asset_storage* storage);
 
+//****************************************************************************
+// completion queue functions
+
+/**
+ * @brief creates a queue that collects finished requests
+ * @details As an alternative to having a parse function pushed to a work
+ *          queue for every file, requests may be submitted with a completion
+ *          queue. The storage threads append a record to the queue as each
+ *          request finishes, and the consumer retrieves the records in
+ *          batches of its choosing.
+ * @param capacity the number of records the queue can hold without
+ *        allocating. Records that do not fit are kept in an overflow list
+ *        rather than blocking the storage threads.
+ * @param cq_out out parameter that will be set to the queue handle
+ */
+taa_ASSET_LINKAGE void taa_asset_create_completion_queue(
+    uint32_t capacity,
+    taa_asset_completion_queue** cq_out);
+
+/**
+ * @details The queue must be empty and no outstanding requests may refer to
+ *          it when it is destroyed.
+ */
+taa_ASSET_LINKAGE void taa_asset_destroy_completion_queue(
+    taa_asset_completion_queue* cq);
+
+/**
+ * @brief retrieves finished requests from a completion queue
+ * @details Records for requests that were cancelled individually are
+ *          discarded rather than returned. Every record that is returned
+ *          must be passed to taa_asset_release_completion.
+ * @param cq the completion queue
+ * @param records_out array that will receive the records
+ * @param maxrecords the size of the records_out array
+ * @return the number of records written to records_out
+ */
+taa_ASSET_LINKAGE uint32_t taa_asset_drain_completions(
+    taa_asset_completion_queue* cq,
+    taa_asset_completion* records_out,
+    uint32_t maxrecords);
+
+/**
+ * @brief hands the data of a completion record back to the storage
+ */
+taa_ASSET_LINKAGE void taa_asset_release_completion(
+    const taa_asset_completion* record);
+
+//****************************************************************************
+// storage plugin functions
+
+/**
+ * @brief passes the data loaded for a request on to its consumer
+ * @details Called by storage plugins from a load function, or from any
+ *          thread for requests that are completed later. Unless the
+ *          request has been cancelled, it is posted to its completion queue
+ *          or its parse function is pushed to its work queue. releasefunc
+ *          is called once the data is no longer needed, which may occur
+ *          before this function returns.
+ * @param req the request that has been fulfilled
+ * @param data the file data, or NULL if the file could not be read
+ * @param size the size of the file data in bytes
+ * @param releasefunc function to call when the data may be reclaimed, or
+ *        NULL if no notification is needed
+ * @param releasedata context data provided to the release function
+ */
+taa_ASSET_LINKAGE void taa_asset_complete_request(
+    taa_asset_file_request* req,
+    const void* data,
+    size_t size,
+    taa_asset_release_func releasefunc,
+    void* releasedata);
+
+/**
+ * @brief determines whether a request was cancelled while it was loading
+ * @details Storage plugins may use this to skip reading data that is no
+ *          longer needed. Such requests must still be completed.
+ */
+taa_ASSET_LINKAGE int taa_asset_is_request_cancelled(
+    const taa_asset_file_request* req);
+
+/**
+ * @brief takes more queued requests for a group from within a load function
+ * @details Requests are only given out while no other group has work that
+ *          is both due and more urgent. Once NULL is returned, the load
+ *          function should finish the requests it holds and return so that
+ *          the storage thread may move on to other work. The requests must
+ *          be completed as if they had been passed to the load function.
+ * @param storage the storage instance of the requests being loaded
+ * @param group the group being loaded
+ * @return a linked list of requests, or NULL if none should be loaded now
+ */
+taa_ASSET_LINKAGE taa_asset_file_request* taa_asset_refill_requests(
+    taa_asset_storage* storage,
+    taa_asset_group* group);
+
 #endif // taa_ASSET_H_
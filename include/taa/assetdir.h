@@ -9,33 +9,191 @@
 
 #include "asset.h"
 
+//****************************************************************************
+// enums
+
+enum
+{
+    // a suitable number of descriptors to keep open for directory storage
+    taa_ASSETDIR_DEFAULT_MAX_FDS = 64
+};
+
+enum taa_asset_dir_storage_flags_e
+{
+    // parse functions are given a pointer into a read only mapping of the
+    // file instead of a copy. the mapping is released after parsing. only
+    // supported on linux; ignored on other platforms.
+    taa_ASSETDIR_MMAP = 1 << 0,
+    // the requests in each batch are ordered by the physical offset of the
+    // files on disk instead of by inode number. each file is opened while
+    // the directory is scanned to query its layout, so scanning is slower.
+    // only supported on linux; ignored on other platforms.
+    taa_ASSETDIR_FIEMAP = 1 << 1
+};
+
+enum taa_asset_dir_change_e
+{
+    // a file was added to the directory
+    taa_ASSETDIR_FILE_ADDED,
+    // a file was deleted or renamed. the entry provided is a copy of the
+    // entry that was removed from the file table, and is only valid for the
+    // duration of the call.
+    taa_ASSETDIR_FILE_REMOVED,
+    // the contents of a file were written or replaced
+    taa_ASSETDIR_FILE_MODIFIED,
+    // the entry of a file moved to another position in the file table, so
+    // any pointers to its previous entry must be updated
+    taa_ASSETDIR_FILE_MOVED
+};
+
 //****************************************************************************
 // typedefs
 
+typedef enum taa_asset_dir_change_e taa_asset_dir_change;
 typedef struct taa_asset_dir_storage_s taa_asset_dir_storage;
 
+/**
+ * @brief function pointer called for each change to a watched group
+ * @details The change has already been applied to the file table of the
+ *          group when the function is called.
+ * @param group the group that changed
+ * @param file the entry of the file in the file table of the group
+ * @param change the kind of change
+ * @param userdata the context data provided to taa_asset_update_dir_storage
+ */
+typedef void (*taa_asset_dir_change_func)(
+    taa_asset_group* group,
+    taa_asset_file* file,
+    taa_asset_dir_change change,
+    void* userdata);
+
 //****************************************************************************
 // functions
 
 /**
  * @brief creates directory manager instance for servicing storage requests
- * @param maxrequests maximum number of requests to service simultaneously
+ * @details File data is read into buffers drawn from a pool of power of two
+ *          size classes. Released buffers are cached for reuse, and are
+ *          freed when room is needed for a buffer of another size. On
+ *          linux, the requests in each batch are read in the order of the
+ *          files on disk.
+ * @param budget the maximum number of bytes of file data held at once,
+ *        including data waiting to be parsed and cached buffers. Loading
+ *        stalls while the budget is exhausted. A single file larger than
+ *        the budget is loaded once nothing else is outstanding.
+ * @param maxfds the number of files that may be kept open between reads.
+ *        On linux, files are read with pread through descriptors that are
+ *        cached in least recently used order, and a file that is not
+ *        cached is opened relative to its directory, which is also kept
+ *        open. The cache is limited to half of the process descriptor
+ *        limit. Zero disables caching. Ignored on other platforms.
+ * @param flags bitwise combination of taa_asset_dir_storage_flags_e values
  * @param mgr_out pointer to output handle
  */
 taa_ASSET_LINKAGE void taa_asset_create_dir_storage(
-    uint32_t maxrequests,
+    size_t budget,
+    uint32_t maxfds,
+    uint32_t flags,
     taa_asset_dir_storage** mgr_out);
 
 taa_ASSET_LINKAGE void taa_asset_destroy_dir_storage(
     taa_asset_dir_storage* mgr);
 
+/**
+ * @brief frees cached buffers that are not in use
+ * @details May be called in response to memory pressure. The largest
+ *          buffers are freed first.
+ * @param mgr the dir storage instance
+ * @param maxcached the number of bytes that may remain cached
+ */
+taa_ASSET_LINKAGE void taa_asset_trim_dir_storage(
+    taa_asset_dir_storage* mgr,
+    size_t maxcached);
+
 /**
  * @brief creates a storage group for the files in the specified path
+ * @details A warning is logged for each pair of files whose file keys or
+ *          type keys collide, since only one of them can be found by its
+ *          key. Files added to a watched directory are checked the same way.
  */
 taa_ASSET_LINKAGE taa_asset_group* taa_asset_scan_dir(
     taa_asset_dir_storage* mgr,
     const char* name,
     const char* path);
 
-#endif // taa_ASSETDIR_H_
+/**
+ * @brief creates a storage group using a manifest of a previous scan
+ * @details The manifest stores the file table of the group along with a
+ *          fingerprint of the directory. If the fingerprint still matches,
+ *          the group is built from the manifest without reading the
+ *          directory. Otherwise the directory is scanned and the manifest
+ *          is rewritten. Only the directory itself is fingerprinted, so a
+ *          file that changes size without being added, removed, or renamed
+ *          is not detected. Manifests are only supported on linux; on other
+ *          platforms this is equivalent to taa_asset_scan_dir.
+ * @param mgr the dir storage instance
+ * @param name the name of the group
+ * @param path the directory containing the files
+ * @param manifestpath the path of the manifest file, which should not be
+ *        inside the directory being scanned
+ */
+taa_ASSET_LINKAGE taa_asset_group* taa_asset_scan_dir_manifest(
+    taa_asset_dir_storage* mgr,
+    const char* name,
+    const char* path,
+    const char* manifestpath);
+
+/**
+ * @brief frees a group created by the dir storage
+ * @details Stops watching the directory of the group, closes the cached
+ *          descriptors of its files and the descriptor of its directory,
+ *          and frees its file tables and names. The group must have been
+ *          removed from any asset maps, and every request for its files
+ *          must have completed or been cancelled. This function must not be
+ *          called concurrently with taa_asset_update_dir_storage.
+ */
+taa_ASSET_LINKAGE void taa_asset_release_dir_group(
+    taa_asset_dir_storage* mgr,
+    taa_asset_group* group);
 
+/**
+ * @brief watches the directory of a group for changes
+ * @details Once a group is watched, files that are added to, removed from,
+ *          or written in its directory are applied to its file table by
+ *          taa_asset_update_dir_storage, without the directory being
+ *          scanned again. Files are picked up once they are closed after
+ *          writing or renamed into the directory. Changes made before the
+ *          group was watched are not detected. Only supported on linux.
+ * @return nonzero if the directory is being watched
+ */
+taa_ASSET_LINKAGE int taa_asset_watch_dir(
+    taa_asset_dir_storage* mgr,
+    taa_asset_group* group);
+
+/**
+ * @brief applies changes to watched directories to their groups
+ * @details Processes the changes that have occurred since the last update
+ *          without blocking. The file table of a group is modified in
+ *          place: a removed file is replaced by the last entry of the
+ *          table, and the table is moved to a larger buffer when a file is
+ *          added to a full table, so entries that move are reported. The
+ *          replaced tables remain allocated until the group is released or
+ *          the storage is destroyed.
+ *          Requests that are in flight are unaffected by changes to the
+ *          table, but a request for a file that is being written may load
+ *          either version of the file. This function must not be called
+ *          concurrently with any other use of the file tables of watched
+ *          groups, such as making requests. If the kernel discards events
+ *          because too many occurred at once, a warning is logged and the
+ *          affected groups must be scanned again.
+ * @param mgr the dir storage instance
+ * @param func called once for each change
+ * @param userdata context data provided to func
+ * @return the number of files that changed
+ */
+taa_ASSET_LINKAGE uint32_t taa_asset_update_dir_storage(
+    taa_asset_dir_storage* mgr,
+    taa_asset_dir_change_func func,
+    void* userdata);
+
+#endif // taa_ASSETDIR_H_
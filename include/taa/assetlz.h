@@ -0,0 +1,54 @@
+/**
+ * @brief     lz block compression header
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2011
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taa_ASSETLZ_H_
+#define taa_ASSETLZ_H_
+
+#include "asset.h"
+
+//****************************************************************************
+// functions
+
+/**
+ * @brief returns the largest possible compressed size of a block
+ */
+taa_ASSET_LINKAGE uint32_t taa_asset_lz_bound(
+    uint32_t size);
+
+/**
+ * @brief compresses a block of data
+ * @details The output uses the LZ4 block format, which favors decompression
+ *          speed over compression ratio. Each block is independent of any
+ *          other block.
+ * @param src the data to compress
+ * @param srcsize the size of the data in bytes
+ * @param dst the buffer that receives the compressed data
+ * @param dstcapacity the size of the destination buffer in bytes
+ * @return the compressed size in bytes, or 0 if it would exceed capacity
+ */
+taa_ASSET_LINKAGE uint32_t taa_asset_lz_compress(
+    const void* src,
+    uint32_t srcsize,
+    void* dst,
+    uint32_t dstcapacity);
+
+/**
+ * @brief decompresses a block of data
+ * @details The input is validated, so malformed data can not cause reads
+ *          or writes outside of the buffers.
+ * @param src the compressed data
+ * @param srcsize the size of the compressed data in bytes
+ * @param dst the buffer that receives the decompressed data
+ * @param dstsize the exact size of the decompressed data in bytes
+ * @return nonzero on success, or zero if the data is malformed
+ */
+taa_ASSET_LINKAGE int taa_asset_lz_decompress(
+    const void* src,
+    uint32_t srcsize,
+    void* dst,
+    uint32_t dstsize);
+
+#endif // taa_ASSETLZ_H_
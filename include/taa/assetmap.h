@@ -28,6 +28,16 @@ struct taa_asset_map_value_s
 //****************************************************************************
 // functions
 
+/**
+ * @brief creates a map of asset keys to storage files
+ * @details Lookups do not take a lock, and may run on any number of threads
+ *          while the map is being changed. Changes are serialized by a lock
+ *          that lookups never wait on. Each change publishes a new hash
+ *          index, and the memory it replaces is freed once no reader can
+ *          still be using it.
+ * @param capacity the number of values to allocate storage for up front
+ * @param map_out pointer to output handle
+ */
 taa_ASSET_LINKAGE void taa_asset_create_map(
     uint32_t capacity,
     taa_asset_map** map_out);
@@ -35,10 +45,68 @@ taa_ASSET_LINKAGE void taa_asset_create_map(
 taa_ASSET_LINKAGE void taa_asset_destroy_map(
     taa_asset_map* map);
 
+/**
+ * @brief marks the start of lookups that may run while the map is changed
+ * @details Until the matching call to taa_asset_end_map_read, the memory of
+ *          the index and of any value found is not freed, even if the value
+ *          is concurrently removed. Entering and leaving increment and
+ *          decrement a counter, and never wait on writers. Lookups that are
+ *          serialized with every change by other means need not be marked.
+ * @return a token to pass to taa_asset_end_map_read
+ */
+taa_ASSET_LINKAGE uint32_t taa_asset_begin_map_read(
+    taa_asset_map* map);
+
+taa_ASSET_LINKAGE void taa_asset_end_map_read(
+    taa_asset_map* map,
+    uint32_t token);
+
+/**
+ * @brief returns the value of a key, or NULL if it is not in the map
+ * @details Keys are found through a hash index with open addressing, so a
+ *          lookup takes constant time on average regardless of the size of
+ *          the map. A new index is published whenever keys are added or
+ *          removed. Lookups that may run while the map is being changed
+ *          must be placed between taa_asset_begin_map_read and
+ *          taa_asset_end_map_read. Members of the value are not protected;
+ *          callers that modify them must synchronize access themselves.
+ */
 taa_ASSET_LINKAGE taa_asset_map_value* taa_asset_find(
     const taa_asset_map* map,
     const taa_asset_key key);
 
+/**
+ * @brief finds the values of several keys at once
+ * @details Produces the same results as calling taa_asset_find for each
+ *          key, but the searches of consecutive keys are interleaved and
+ *          prefetched, so that their cache misses overlap. This is faster
+ *          than separate lookups when the map is too large to stay in the
+ *          cache. The same rules for running concurrently with changes
+ *          apply as for taa_asset_find.
+ * @param keys the keys to search for
+ * @param numkeys the number of keys
+ * @param values_out receives the value of each key, or NULL for keys that
+ *        are not in the map
+ */
+taa_ASSET_LINKAGE void taa_asset_find_many(
+    const taa_asset_map* map,
+    const taa_asset_key* keys,
+    uint32_t numkeys,
+    taa_asset_map_value** values_out);
+
+/**
+ * @brief inserts a single file into the map
+ * @details If the key of the file is already in the map, its value is
+ *          updated to refer to the file and its asset is kept. Values are
+ *          never moved, so a pointer to a value stays valid until its key
+ *          is removed.
+ * @return the value of the file
+ */
+taa_ASSET_LINKAGE taa_asset_map_value* taa_asset_insert(
+    taa_asset_map* map,
+    taa_asset_group* group,
+    taa_asset_file* file);
+
 /**
  * @details iterates the storage group and inserts all files matching the
  *          specified type key into the map
@@ -48,4 +116,46 @@ taa_ASSET_LINKAGE void taa_asset_register_group(
     taa_asset_group* group,
     uint32_t typekey);
 
+/**
+ * @brief inserts all files of a group matching any of several type keys
+ * @details The file table is walked once. The keys of the matching files
+ *          are radix sorted and then merged into the map in a single pass,
+ *          so registering a group takes linear time. If a key is already in
+ *          the map, its value is updated to refer to the new file and its
+ *          asset is kept. If two files in the group have the same key, a
+ *          warning is logged and the first file is used. The warning tells
+ *          a hash collision between different names apart from a name that
+ *          is registered with more than one of the types.
+ */
+taa_ASSET_LINKAGE void taa_asset_register_group_types(
+    taa_asset_map* map,
+    taa_asset_group* group,
+    const uint32_t* typekeys,
+    uint32_t numtypekeys);
+
+/**
+ * @brief removes every key of a storage group from the map
+ * @details Keys that have since been given to a newer group with the same
+ *          key, such as when a directory is scanned again, are kept. The
+ *          keys of the group are removed with a single move of the keys
+ *          that follow them, so the time taken is linear in the size of the
+ *          map. The memory of the values is reused once no reader
+ *          that may have found them is still reading. The assets the values
+ *          referred to are not released; callers that keep assets for the
+ *          keys must release them, and must not request the files of the
+ *          group once the group itself is released.
+ */
+taa_ASSET_LINKAGE void taa_asset_unregister_group(
+    taa_asset_map* map,
+    taa_asset_group* group);
+
+/**
+ * @brief removes a key from the map if it is present
+ * @details The memory of the value is reused once no reader that may have
+ *          found it is still reading.
+ */
+taa_ASSET_LINKAGE void taa_asset_remove(
+    taa_asset_map* map,
+    const taa_asset_key key);
+
 #endif // taa_ASSETMAP_H_
@@ -0,0 +1,146 @@
+/**
+ * @brief     asset file storage in packed archives header
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2011
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#ifndef taa_ASSETPACK_H_
+#define taa_ASSETPACK_H_
+
+#include "asset.h"
+
+// set in the block size table for blocks that are stored uncompressed
+#define taa_ASSETPACK_BLOCK_STORED 0x80000000U
+
+//****************************************************************************
+// enums
+
+enum
+{
+    // identifies a pack file: 'taap' in little endian order
+    taa_ASSETPACK_MAGIC = 0x70616174,
+    // must be incremented whenever the pack format or the key hash changes
+    taa_ASSETPACK_VERSION = 4,
+    // the default alignment of the file data within a pack
+    taa_ASSETPACK_DEFAULT_ALIGNMENT = 64,
+    // the default size of the uncompressed blocks of compressed files
+    taa_ASSETPACK_DEFAULT_BLOCK_SIZE = 64 * 1024
+};
+
+enum taa_asset_pack_storage_flags_e
+{
+    // packs are memory mapped and parse functions are given a pointer into
+    // the mapping instead of a copy. only supported on linux; ignored on
+    // other platforms.
+    taa_ASSETPACK_MMAP = 1 << 0,
+    // requests for files that are stored close together in a pack are read
+    // with a single larger read. the files share one buffer, which is freed
+    // once every file in it has been released.
+    taa_ASSETPACK_MERGE_READS = 1 << 1
+};
+
+enum taa_asset_pack_entry_flags_e
+{
+    // the file data is split into blocks compressed with taa_asset_lz
+    taa_ASSETPACK_ENTRY_COMPRESSED = 1 << 0
+};
+
+//****************************************************************************
+// typedefs
+
+typedef struct taa_asset_pack_header_s taa_asset_pack_header;
+typedef struct taa_asset_pack_entry_s taa_asset_pack_entry;
+typedef struct taa_asset_pack_storage_s taa_asset_pack_storage;
+
+//****************************************************************************
+// structs
+
+/**
+ * @brief the header at the start of a pack file
+ * @details The header is followed by the table of contents, which is an
+ *          array of entries sorted by type key and then file key. The table
+ *          is followed by the file names, and then by the file data. Values
+ *          are stored in little endian byte order.
+ */
+struct taa_asset_pack_header_s
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numentries;
+    // the size in bytes of the file names, including the terminators
+    uint32_t namessize;
+    // the data of every file begins at a multiple of the alignment
+    uint32_t alignment;
+    // the uncompressed size of every block of a compressed file except the
+    // last, which may be smaller
+    uint32_t blocksize;
+    // the offset from the start of the pack to the first file
+    uint64_t dataoffset;
+};
+
+/**
+ * @brief a table of contents entry in a pack file
+ * @details The stored data of a compressed file begins with a table of the
+ *          compressed size of each block, followed by the blocks. Blocks
+ *          that did not compress are stored as is and are marked with
+ *          taa_ASSETPACK_BLOCK_STORED in the table.
+ */
+struct taa_asset_pack_entry_s
+{
+    uint32_t typekey;
+    uint32_t filekey;
+    // the offset of the name from the start of the file names
+    uint32_t nameoffset;
+    // the uncompressed size of the file
+    uint32_t size;
+    // the offset of the stored data from the start of the pack
+    uint64_t offset;
+    // the number of bytes of stored data
+    uint32_t storedsize;
+    // bitwise combination of taa_asset_pack_entry_flags_e values
+    uint32_t flags;
+};
+
+//****************************************************************************
+// functions
+
+/**
+ * @brief creates pack manager instance for servicing storage requests
+ * @details The requests in each batch are sorted by the offset of the file
+ *          data, so a pack is read from front to back. On linux, files are
+ *          read with pread through a descriptor that is kept open for the
+ *          lifetime of the pack. On other platforms, the files loaded in
+ *          each batch are read through a single handle to the pack.
+ *          Compressed files are decompressed before they are parsed, and
+ *          requests for a range of a compressed file only read and
+ *          decompress the blocks that hold the range. Each block is
+ *          decompressed by a separate task on the decompression work queue,
+ *          so the blocks of a large file are decompressed in parallel. Once
+ *          the last block of a file is done, the request is delivered to its
+ *          own work queue or completion queue as usual.
+ * @param flags bitwise combination of taa_asset_pack_storage_flags_e values
+ * @param wq the work queue on which blocks are decompressed. It should be
+ *        serviced by worker threads rather than by the threads that drain
+ *        parse work. If NULL, blocks are decompressed on the storage thread.
+ * @param mgr_out pointer to output handle
+ */
+taa_ASSET_LINKAGE void taa_asset_create_pack_storage(
+    uint32_t flags,
+    taa_workqueue* wq,
+    taa_asset_pack_storage** mgr_out);
+
+taa_ASSET_LINKAGE void taa_asset_destroy_pack_storage(
+    taa_asset_pack_storage* mgr);
+
+/**
+ * @brief creates a storage group for the files in the specified pack
+ * @details The files of the group are in table of contents order, and the
+ *          handle of each file is the offset of its data within the pack.
+ * @return the group, or NULL if the pack could not be opened or is invalid
+ */
+taa_ASSET_LINKAGE taa_asset_group* taa_asset_open_pack(
+    taa_asset_pack_storage* mgr,
+    const char* name,
+    const char* path);
+
+#endif // taa_ASSETPACK_H_
@@ -1,6 +1,8 @@
 #include "src/asset.c"
 #include "src/assetcache.c"
 #include "src/assetdir.c"
+#include "src/assetlz.c"
 #include "src/assetmap.c"
+#include "src/assetpack.c"
 #include "src/assetstorage.c"
 
@@ -5,9 +5,185 @@
  * @copyright unlicense / public domain
  ****************************************************************************/
 #include <taa/asset.h>
-#include <taa/hash.h>
 #include <taa/path.h>
 #include <ctype.h>
+#include <string.h>
+
+// the second set of keys, used for the lower half of 64 bit file keys, is
+// the first set with these bits flipped
+#define taa_ASSET_HASH_INIT64 0x8e69c604e3304ff5ULL
+#define taa_ASSET_HASH_SECRET64 0x9038c7e0117f7295ULL
+
+#define taa_ASSET_HASH_ONES 0x0101010101010101ULL
+
+static const uint64_t taa_asset_hash_keys[16] =
+{
+    taa_ASSET_HASH_K0,
+    taa_ASSET_HASH_K1,
+    taa_ASSET_HASH_K2,
+    taa_ASSET_HASH_K3,
+    taa_ASSET_HASH_K4,
+    taa_ASSET_HASH_K5,
+    taa_ASSET_HASH_K6,
+    taa_ASSET_HASH_K7,
+    taa_ASSET_HASH_K8,
+    taa_ASSET_HASH_K9,
+    taa_ASSET_HASH_K10,
+    taa_ASSET_HASH_K11,
+    taa_ASSET_HASH_K12,
+    taa_ASSET_HASH_K13,
+    taa_ASSET_HASH_K14,
+    taa_ASSET_HASH_K15
+};
+
+//****************************************************************************
+// converts the upper case ascii letters of eight bytes to lower case, which
+// is what tolower does in the C locale. bytes outside of the ascii range are
+// left as they are.
+static uint64_t taa_asset_lower8(
+    uint64_t w)
+{
+    uint64_t low7 = w & (0x7f * taa_ASSET_HASH_ONES);
+    // the high bit of each byte is set if the byte is at least 'A', and if
+    // it is greater than 'Z'. the low seven bits can not carry.
+    uint64_t ge = low7 + (0x80 - 'A') * taa_ASSET_HASH_ONES;
+    uint64_t gt = low7 + (0x7f - 'Z') * taa_ASSET_HASH_ONES;
+    uint64_t upper = ge & ~gt & ~w & (0x80 * taa_ASSET_HASH_ONES);
+    return w | (upper >> 2);
+}
+
+//****************************************************************************
+// reads four bytes as a little endian value
+static uint32_t taa_asset_read32(
+    const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+//****************************************************************************
+// reads eight bytes as a little endian value
+static uint64_t taa_asset_read64(
+    const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+//****************************************************************************
+// returns the key constant for a 32 bit chunk of a name. the keys repeat
+// every 16 chunks, offset by a different amount each time.
+static uint64_t taa_asset_hash_key(
+    size_t chunk)
+{
+    return taa_asset_hash_keys[chunk & 15] +
+        (chunk >> 4) * taa_ASSET_HASH_ROUND;
+}
+
+//****************************************************************************
+// hashes a range of characters as if each had been converted to lower case.
+// the characters are read eight at a time rather than being copied to a
+// converted string first. each 32 bit chunk of the range is multiplied by
+// the key constant for its position, and the key is the upper half of the
+// sum of the products. if a second result is requested, the products of
+// a second set of keys are summed as well.
+static uint32_t taa_asset_hash(
+    const char* src,
+    size_t len,
+    uint32_t* second_out)
+{
+    uint64_t acc = taa_ASSET_HASH_INIT;
+    uint64_t acc2 = taa_ASSET_HASH_INIT64;
+    const char* end = src + len;
+    size_t chunk = 0;
+    while(src != end)
+    {
+        size_t n = end - src;
+        uint64_t w;
+        uint64_t k0 = taa_asset_hash_key(chunk);
+        uint64_t k1 = taa_asset_hash_key(chunk + 1);
+        if(n >= 8)
+        {
+            w = taa_asset_read64(src);
+            n = 8;
+        }
+        else if(n >= 4)
+        {
+            // the last partial word is read with overlapping loads, which
+            // place any byte that is read twice in the same position, and
+            // is padded with zeros
+            w = taa_asset_read32(src);
+            w |= ((uint64_t) taa_asset_read32(end - 4)) << ((n - 4) * 8);
+        }
+        else
+        {
+            w = (unsigned char) src[0];
+            w |= ((uint64_t) (unsigned char) src[n >> 1]) << ((n >> 1) * 8);
+            w |= ((uint64_t) (unsigned char) src[n - 1]) << ((n - 1) * 8);
+        }
+        w = taa_asset_lower8(w);
+        acc += (w & 0xffffffffU) * k0 + (w >> 32) * k1;
+        if(second_out != NULL)
+        {
+            k0 ^= taa_ASSET_HASH_SECRET64;
+            k1 ^= taa_ASSET_HASH_SECRET64;
+            acc2 += (w & 0xffffffffU) * k0 + (w >> 32) * k1;
+        }
+        src += n;
+        chunk += 2;
+    }
+    if(second_out != NULL)
+    {
+        *second_out = (uint32_t) (acc2 >> 32);
+    }
+    return (uint32_t) (acc >> 32);
+}
+
+//****************************************************************************
+// finds the part of a file name that identifies the file, which excludes
+// its directory and extension
+static const char* taa_asset_file_stem(
+    const char* name,
+    size_t* len_out)
+{
+    const char* begin = strrchr(name, taa_PATH_SLASH);
+    const char* end;
+    begin = (begin != NULL) ? begin + 1 : name;
+    end = strchr(begin, '.');
+    *len_out = (end != NULL) ? (size_t) (end - begin) : strlen(begin);
+    return begin;
+}
+
+//****************************************************************************
+// finds the extension of a file name, or the whole name if it has none
+static const char* taa_asset_file_ext(
+    const char* name)
+{
+    const char* ext = strrchr(name, '.');
+    return (ext != NULL) ? ext + 1 : name;
+}
+
+//****************************************************************************
+// compares two ranges of characters, ignoring the case of ascii letters
+static int taa_asset_same_chars(
+    const char* a,
+    size_t lena,
+    const char* b,
+    size_t lenb)
+{
+    size_t i = 0;
+    if(lena == lenb)
+    {
+        while(i < lena &&
+              tolower((unsigned char) a[i]) == tolower((unsigned char) b[i]))
+        {
+            ++i;
+        }
+    }
+    return lena == lenb && i == lena;
+}
 
 //****************************************************************************
 taa_asset_key taa_asset_gen_key(
@@ -24,65 +200,55 @@ taa_asset_key taa_asset_gen_key(
 uint32_t taa_asset_gen_filekey(
     const char* name)
 {
-    char fmtname[taa_PATH_SIZE];
-    char* dstitr = fmtname;
-    char* dstend = fmtname + sizeof(fmtname);
-    const char* srcitr;
-    const char* srcend;
-    srcitr = strrchr(name, taa_PATH_SLASH);
-    srcitr = (srcitr != NULL) ? srcitr + 1 : name;
-    srcend = strchr(srcitr, '.');
-    srcend = (srcend != NULL) ? srcend + 1 : srcitr + strlen(srcitr) + 1;
-    while(dstitr != dstend && srcitr != srcend)
-    {
-        *dstitr = tolower(*srcitr);
-        ++dstitr;
-        ++srcitr;
-    }
-    --dstitr;
-    *dstitr = '\0';
-    return taa_hash_pjw(fmtname);
+    size_t len;
+    const char* stem = taa_asset_file_stem(name, &len);
+    return taa_asset_hash(stem, len, NULL);
+}
+
+//****************************************************************************
+uint64_t taa_asset_gen_filekey64(
+    const char* name)
+{
+    size_t len;
+    const char* stem = taa_asset_file_stem(name, &len);
+    uint32_t lo;
+    uint32_t hi = taa_asset_hash(stem, len, &lo);
+    return (((uint64_t) hi) << 32) | lo;
 }
 
 //****************************************************************************
 uint32_t taa_asset_gen_groupkey(
     const char* name)
 {
-    char fmtname[taa_PATH_SIZE];
-    char* dstitr = fmtname;
-    char* dstend = fmtname + sizeof(fmtname);
-    const char* srcitr = name;
-    const char* srcend = srcitr + strlen(srcitr) + 1;
-    while(dstitr != dstend && srcitr != srcend)
-    {
-        *dstitr = tolower(*srcitr);
-        ++dstitr;
-        ++srcitr;
-    }
-    --dstitr;
-    *dstitr = '\0';
-    return taa_hash_pjw(fmtname);
+    return taa_asset_hash(name, strlen(name), NULL);
 }
 
 //****************************************************************************
 uint32_t taa_asset_gen_typekey(
     const char* ext)
 {
-    char fmtext[taa_PATH_SIZE];
-    char* dstitr = fmtext;
-    char* dstend = fmtext + sizeof(fmtext);
-    const char* srcitr;
-    const char* srcend;
-    srcitr = strrchr(ext, '.');
-    srcitr = (srcitr != NULL) ? srcitr + 1 : ext;
-    srcend = srcitr + strlen(srcitr) + 1;
-    while(dstitr != dstend && srcitr != srcend)
-    {
-        *dstitr = tolower(*srcitr);
-        ++dstitr;
-        ++srcitr;
-    }
-    --dstitr;
-    *dstitr = '\0';
-    return taa_hash_pjw(fmtext);
+    const char* src = taa_asset_file_ext(ext);
+    return taa_asset_hash(src, strlen(src), NULL);
+}
+
+//****************************************************************************
+int taa_asset_same_file_stem(
+    const char* name0,
+    const char* name1)
+{
+    size_t len0;
+    size_t len1;
+    const char* stem0 = taa_asset_file_stem(name0, &len0);
+    const char* stem1 = taa_asset_file_stem(name1, &len1);
+    return taa_asset_same_chars(stem0, len0, stem1, len1);
+}
+
+//****************************************************************************
+int taa_asset_same_file_ext(
+    const char* ext0,
+    const char* ext1)
+{
+    const char* src0 = taa_asset_file_ext(ext0);
+    const char* src1 = taa_asset_file_ext(ext1);
+    return taa_asset_same_chars(src0, strlen(src0), src1, strlen(src1));
 }
@@ -5,24 +5,92 @@
  * @copyright unlicense / public domain
  ****************************************************************************/
 #include <taa/assetdir.h>
+#include <taa/log.h>
 #include <taa/path.h>
 #include <taa/semaphore.h>
+#include <taa/spinlock.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// on linux, files are read through io_uring so that many reads may be in
+// flight at once. define taa_ASSETDIR_NO_URING to always use stdio.
+#if defined(__linux__) && !defined(taa_ASSETDIR_NO_URING)
+#define taa_ASSETDIR_URING
+#endif
+
+// memory mapped loading relies on MAP_POPULATE, directories are read with
+// the getdents64 system call, open files are cached as descriptors that are
+// read with pread, and directories are watched for changes with inotify;
+// all are linux specific
+#if defined(__linux__)
+#define taa_ASSETDIR_MMAP_SUPPORTED
+#define taa_ASSETDIR_GETDENTS
+#define taa_ASSETDIR_FDCACHE
+#define taa_ASSETDIR_INOTIFY
+#endif
+
+#ifdef taa_ASSETDIR_URING
+#include <linux/io_uring.h>
+#include <errno.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 typedef struct taa_assetdir_buf_s taa_assetdir_buf;
 typedef struct taa_assetdir_strings_s taa_assetdir_strings;
+typedef struct taa_assetdir_file_s taa_assetdir_file;
+typedef struct taa_assetdir_table_s taa_assetdir_table;
 typedef struct taa_assetdir_s taa_assetdir;
+typedef struct taa_assetdir_scan_entry_s taa_assetdir_scan_entry;
+typedef struct taa_assetdir_scan_s taa_assetdir_scan;
+typedef struct taa_assetdir_manifest_s taa_assetdir_manifest;
+#ifdef taa_ASSETDIR_GETDENTS
+typedef struct taa_assetdir_dirent64_s taa_assetdir_dirent64;
+#endif
+#ifdef taa_ASSETDIR_FDCACHE
+typedef struct taa_assetdir_fd_s taa_assetdir_fd;
+#endif
+#ifdef taa_ASSETDIR_URING
+typedef struct taa_assetdir_slot_s taa_assetdir_slot;
+typedef struct taa_assetdir_ring_s taa_assetdir_ring;
+#endif
+
+enum
+{
+    // buffers are allocated in power of two size classes starting at 64k.
+    // the last class is large enough for any file with a 32 bit size.
+    taa_ASSETDIR_MIN_CLASS_SHIFT = 16,
+    taa_ASSETDIR_NUM_CLASSES = 17,
+    // identifies a scan manifest file: 'taam' in little endian order
+    taa_ASSETDIR_MANIFEST_MAGIC = 0x6d616174,
+    // must be incremented whenever the manifest format or the key hash
+    // changes
+    taa_ASSETDIR_MANIFEST_VERSION = 4
+};
 
 struct taa_assetdir_buf_s
 {
     void* data;
-    taa_semaphore* sem;
-    uint32_t size;
-    uint32_t capacity;
-    taa_asset_parse_func parsefunc;
-    void* userdata;
+    taa_asset_dir_storage* mgr;
+    // the number of bytes charged against the budget
+    size_t size;
+    // the size class of the buffer, or -1 if data is a file mapping
+    int32_t sizeclass;
+    taa_assetdir_buf* next;
 };
 
 struct taa_assetdir_strings_s
@@ -32,29 +100,230 @@ struct taa_assetdir_strings_s
     char buf[2048];
 };
 
+struct taa_assetdir_scan_entry_s
+{
+    // the position of the file on disk, used to order reads
+    uint64_t sortkey;
+    uint32_t nameoffset;
+    uint32_t size;
+    uint32_t typekey;
+    uint32_t filekey;
+};
+
+// accumulates the files found while reading a directory
+struct taa_assetdir_scan_s
+{
+    taa_assetdir_scan_entry* entries;
+    uint32_t numentries;
+    uint32_t entrycapacity;
+    char* names;
+    uint32_t namessize;
+    uint32_t namescapacity;
+};
+
+// the header of a scan manifest file. it is followed by the scan entries and
+// then the file names. the manifest is only valid on the machine that wrote
+// it, so values are stored in native byte order.
+struct taa_assetdir_manifest_s
+{
+    uint32_t magic;
+    uint32_t version;
+    // fingerprint of the directory at the time it was scanned
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtimesec;
+    int64_t mtimensec;
+    uint32_t numentries;
+    uint32_t namessize;
+    // the taa_ASSETDIR_FIEMAP flag, if the sort keys are physical offsets
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+#ifdef taa_ASSETDIR_GETDENTS
+// the record format returned by the getdents64 system call
+struct taa_assetdir_dirent64_s
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+#ifdef taa_ASSETDIR_FDCACHE
+// an open descriptor in the cache. entries are kept in a list ordered from
+// the most to the least recently used.
+struct taa_assetdir_fd_s
+{
+    // the cache slot of the file the descriptor belongs to, or NULL if the
+    // entry is unused
+    taa_assetdir_fd** owner;
+    int fd;
+    // the number of reads using the descriptor, which may not be closed
+    // until there are none
+    int32_t refs;
+    taa_assetdir_fd* prev;
+    taa_assetdir_fd* next;
+};
+#endif
+
+// the storage data of a file. the handle of a file points to the path at
+// the end of the struct, so the handle is also the path of the file. when a
+// watched file changes, it is given new data rather than modifying the old,
+// and the old data is kept until the group is released, so requests that
+// are in flight are unaffected.
+struct taa_assetdir_file_s
+{
+    // the position of the file on disk, used to order reads
+    uint64_t sortkey;
+    const char* name;
+#ifdef taa_ASSETDIR_FDCACHE
+    // the cache entry of the file, or NULL if it is not open. guarded by the
+    // manager lock.
+    taa_assetdir_fd* fd;
+#endif
+    // the next data allocated for changes to a watched group
+    taa_assetdir_file* next;
+    char path[1];
+};
+
+// a file table allocated when a watched group outgrows its previous table.
+// replaced tables are kept until the group is released, since requests
+// and completions may still refer to their entries.
+struct taa_assetdir_table_s
+{
+    taa_assetdir_table* next;
+    taa_asset_file files[1];
+};
+
 struct taa_assetdir_s
 {
     taa_asset_group group;
     taa_asset_dir_storage* mgr;
+#ifdef taa_ASSETDIR_FDCACHE
+    // the directory that files are opened relative to, or -1
+    int dfd;
+#endif
+#ifdef taa_ASSETDIR_INOTIFY
+    // the path of the directory
+    const char* path;
+    // the inotify watch of the directory, or -1 if it is not watched
+    int wd;
+    // the number of files the current file table can hold
+    uint32_t capacity;
+    taa_assetdir_table* tables;
+    taa_assetdir_file* files;
+#endif
+    // the names that are not part of the group buffer
+    taa_assetdir_strings* strings;
     taa_assetdir* next;
 };
 
+#ifdef taa_ASSETDIR_URING
+
+enum
+{
+    // the number of reads each ring may have in flight
+    taa_ASSETDIR_RING_DEPTH = 32
+};
+
+enum taa_assetdir_slot_state_e
+{
+    taa_ASSETDIR_SLOT_FREE,
+    taa_ASSETDIR_SLOT_OPENING,
+    taa_ASSETDIR_SLOT_READING
+};
+
+// tracks a single file request while its operations are in flight
+struct taa_assetdir_slot_s
+{
+    taa_asset_file_request* req;
+    taa_assetdir_buf* buf;
+    int fd;
+    // the cache entry holding the descriptor, or NULL if it is not cached
+    taa_assetdir_fd* entry;
+    int32_t state;
+    // the number of bytes read so far
+    uint32_t offset;
+};
+
+struct taa_assetdir_ring_s
+{
+    int fd;
+    int32_t inuse;
+    // submission queue
+    uint32_t* sqhead;
+    uint32_t* sqtail;
+    uint32_t sqmask;
+    uint32_t* sqarray;
+    struct io_uring_sqe* sqes;
+    // entries that have been written but not yet submitted
+    uint32_t numpending;
+    // completion queue
+    uint32_t* cqhead;
+    uint32_t* cqtail;
+    uint32_t cqmask;
+    struct io_uring_cqe* cqes;
+    // mapped memory
+    void* sqmem;
+    size_t sqsize;
+    void* cqmem;
+    size_t cqsize;
+    size_t sqesize;
+    taa_assetdir_slot slots[taa_ASSETDIR_RING_DEPTH];
+    taa_assetdir_ring* next;
+};
+
+#endif // taa_ASSETDIR_URING
+
 struct taa_asset_dir_storage_s
 {
+    // signaled whenever a buffer is released
     taa_semaphore sem;
-    uint32_t numbuffers;
-    taa_assetdir_buf* buffers;
+    // guards the buffer pool when multiple storage threads are loading
+    uint32_t lock;
+    // the maximum number of bytes in use and cached at once
+    size_t budget;
+    // the number of bytes in buffers that have been acquired
+    size_t inflight;
+    // the number of bytes in the free lists
+    size_t cached;
+    taa_assetdir_buf* freebufs[taa_ASSETDIR_NUM_CLASSES];
+    // unused headers for file mappings, which have no buffer of their own
+    taa_assetdir_buf* freemaps;
     taa_assetdir* dirs;
-    taa_assetdir_strings* stringbuf;
+    uint32_t flags;
+#ifdef taa_ASSETDIR_FDCACHE
+    // the entries of the descriptor cache, and the list of entries from the
+    // most to the least recently used. guarded by the lock.
+    taa_assetdir_fd* fds;
+    taa_assetdir_fd* fdhead;
+    taa_assetdir_fd* fdtail;
+#endif
+#ifdef taa_ASSETDIR_INOTIFY
+    // reports changes to watched directories, or -1 until the first
+    // directory is watched
+    int inotifyfd;
+#endif
+#ifdef taa_ASSETDIR_URING
+    // one ring is created for each storage thread that loads concurrently.
+    // guarded by the lock.
+    taa_assetdir_ring* rings;
+    // set if io_uring is not supported by the running kernel
+    int32_t nouring;
+#endif
 };
 
 //****************************************************************************
 // copies contents of a string to a duplicate allocated from the string table
+// of a group, so that it is freed along with the group
 static const char* taa_assetdir_strdup(
-    taa_asset_dir_storage* mgr,
+    taa_assetdir* dir,
     const char* src)
 {
-    taa_assetdir_strings* strbuf = mgr->stringbuf;
+    taa_assetdir_strings* strbuf = dir->strings;
     uint32_t sz = strlen(src) + 1;
     char* dst;
     while(strbuf != NULL)
@@ -71,8 +340,8 @@ static const char* taa_assetdir_strdup(
         // if no string tables exist with enough space, allocate one
         strbuf = (taa_assetdir_strings*) malloc(sizeof(*strbuf));
         strbuf->offset = 0;
-        strbuf->next = mgr->stringbuf;
-        mgr->stringbuf = strbuf;
+        strbuf->next = dir->strings;
+        dir->strings = strbuf;
     }
     dst = strbuf->buf + strbuf->offset;
     strbuf->offset += sz;
@@ -81,244 +350,2125 @@ static const char* taa_assetdir_strdup(
 }
 
 //****************************************************************************
-// called on one of the workqueue threads to execute the parse function
-static void taa_assetdir_parse(
-    void* userdata)
+// removes cached buffers from the free lists, largest first, until no more
+// than the specified number of bytes remain cached. the lock must be held.
+// the evicted buffers are returned as a list to be freed after unlocking.
+static taa_assetdir_buf* taa_assetdir_evict(
+    taa_asset_dir_storage* mgr,
+    size_t maxcached)
 {
-    taa_assetdir_buf* buf = (taa_assetdir_buf*) userdata;
-    // execute the specified function to parse it
-    buf->parsefunc(buf->data, buf->size, buf->userdata);
-    // instruct the storage thread that we're done with the buffer
-    buf->parsefunc = NULL;
-    taa_semaphore_post(buf->sem);
+    taa_assetdir_buf* evicted = NULL;
+    int32_t sizeclass = taa_ASSETDIR_NUM_CLASSES - 1;
+    while(mgr->cached > maxcached && sizeclass >= 0)
+    {
+        taa_assetdir_buf* buf = mgr->freebufs[sizeclass];
+        if(buf != NULL)
+        {
+            mgr->freebufs[sizeclass] = buf->next;
+            mgr->cached -= buf->size;
+            buf->next = evicted;
+            evicted = buf;
+        }
+        else
+        {
+            --sizeclass;
+        }
+    }
+    return evicted;
 }
 
 //****************************************************************************
-// called on the storage thread to load the contents of a set of files
-static void taa_assetdir_load(
-    taa_asset_group* group,
-    taa_asset_file_request* requests)
+// acquires a buffer with room for the specified size, or a header for a
+// mapping of that size if map is true. if acquiring it would exceed the
+// budget, waits for buffers to be released unless wait is false, in which
+// case NULL is returned. a request larger than the whole budget is allowed
+// once nothing else is in flight.
+static taa_assetdir_buf* taa_assetdir_acquire(
+    taa_asset_dir_storage* mgr,
+    uint32_t sz,
+    int map,
+    int wait)
 {
-    taa_assetdir* dir = (taa_assetdir*) group;
-    taa_asset_dir_storage* mgr = dir->mgr;
-    taa_asset_file_request* req = requests;
-    while(req != NULL)
+    taa_assetdir_buf* buf = NULL;
+    taa_assetdir_buf** freelist = &mgr->freemaps;
+    int32_t sizeclass = -1;
+    size_t size = sz;
+    int ok = 0;
+    if(!map)
+    {
+        // find the smallest size class that fits
+        sizeclass = 0;
+        size = ((size_t) 1) << taa_ASSETDIR_MIN_CLASS_SHIFT;
+        while(size < sz && sizeclass < taa_ASSETDIR_NUM_CLASSES - 1)
+        {
+            size <<= 1;
+            ++sizeclass;
+        }
+        freelist = mgr->freebufs + sizeclass;
+    }
+    while(1)
     {
-        taa_asset_file* file = req->file;
-        taa_assetdir_buf* buf = NULL;
-        uint32_t sz = file->size;
-        uint32_t cap = 0;
-        FILE* fp;
-        // find a buffer to read the data into
-        while(1)
-        {
-            taa_assetdir_buf* bufitr = mgr->buffers;
-            taa_assetdir_buf* bufend = bufitr + mgr->numbuffers;
-            while(bufitr != bufend)
+        taa_assetdir_buf* evicted = NULL;
+        taa_SPINLOCK_LOCK(&mgr->lock);
+        ok = (mgr->inflight == 0) || (mgr->inflight + size <= mgr->budget);
+        if(ok)
+        {
+            buf = *freelist;
+            if(buf != NULL)
             {
-                // if the buffer is not in use
-                if(bufitr->parsefunc == NULL)
-                {
-                    // if previous buffer is too small and new one is bigger
-                    // select the new one
-                    if(buf == NULL || (cap < sz && bufitr->capacity > cap))
-                    {
-                        buf = bufitr;
-                        cap =buf->capacity;
-                    }
-                }
-                ++bufitr;
+                *freelist = buf->next;
+                mgr->cached -= (map) ? 0 : size;
             }
-            // if a buffer was found, stop searching
-            if(buf != NULL)
+            else if(!map)
             {
-                break;
+                // a new buffer is needed, so evict cached buffers of other
+                // sizes to make room for it within the budget
+                size_t avail = 0;
+                if(mgr->inflight + size < mgr->budget)
+                {
+                    avail = mgr->budget - mgr->inflight - size;
+                }
+                evicted = taa_assetdir_evict(mgr, avail);
             }
-            // if all the buffers are in use, wait for a signal
-            taa_semaphore_wait(&mgr->sem);
+            mgr->inflight += size;
         }
-        // if the selected buffer is too small, resize it
-        if(cap < sz)
+        taa_SPINLOCK_UNLOCK(&mgr->lock);
+        while(evicted != NULL)
         {
-            // fit to the nearest 65k
-            enum { MEM_CHUNK = 65536 };
-            cap = (sz+(MEM_CHUNK-1)) & ~(MEM_CHUNK-1);
-            buf->data = realloc(buf->data, cap);
-            buf->capacity = cap;
+            // free evicted buffers after lock is released
+            taa_assetdir_buf* next = evicted->next;
+            free(evicted);
+            evicted = next;
         }
-        // attempt to load the file
-        fp = fopen((const char*) file->handle, "rb");
-        if(fp != NULL)
+        if(ok || !wait)
         {
-            if(fread(buf->data, 1, sz, fp) != sz)
-            {
-                sz = 0;
-            }
-            fclose(fp);
+            break;
+        }
+        // wait until some buffer is released
+        taa_semaphore_wait(&mgr->sem);
+    }
+    if(ok && buf == NULL)
+    {
+        // allocate the header and data in a single block
+        size_t offset = (sizeof(*buf) + 63) & ~((size_t) 63);
+        size_t datasize = (map) ? 0 : size;
+        buf = (taa_assetdir_buf*) malloc(offset + datasize);
+        buf->data = (map) ? NULL : ((unsigned char*) buf) + offset;
+        buf->mgr = mgr;
+        buf->sizeclass = sizeclass;
+    }
+    if(buf != NULL)
+    {
+        buf->size = size;
+    }
+    return buf;
+}
+
+//****************************************************************************
+// called once the data in a buffer has been parsed or discarded
+static void taa_assetdir_release(
+    void* releasedata)
+{
+    taa_assetdir_buf* buf = (taa_assetdir_buf*) releasedata;
+    taa_asset_dir_storage* mgr = buf->mgr;
+    taa_assetdir_buf** freelist = &mgr->freemaps;
+    if(buf->sizeclass >= 0)
+    {
+        freelist = mgr->freebufs + buf->sizeclass;
+    }
+#ifdef taa_ASSETDIR_MMAP_SUPPORTED
+    else if(buf->data != NULL)
+    {
+        munmap(buf->data, buf->size);
+        buf->data = NULL;
+    }
+#endif
+    // return the buffer to its free list
+    taa_SPINLOCK_LOCK(&mgr->lock);
+    mgr->inflight -= buf->size;
+    if(buf->sizeclass >= 0)
+    {
+        mgr->cached += buf->size;
+    }
+    buf->next = *freelist;
+    *freelist = buf;
+    taa_SPINLOCK_UNLOCK(&mgr->lock);
+    // instruct the storage thread that we're done with the buffer
+    taa_semaphore_post(&mgr->sem);
+}
+
+//****************************************************************************
+// returns the storage data of a file from its handle
+static taa_assetdir_file* taa_assetdir_file_data(
+    uintptr_t handle)
+{
+    return (taa_assetdir_file*) (handle - offsetof(taa_assetdir_file, path));
+}
+
+#ifdef taa_ASSETDIR_FDCACHE
+
+//****************************************************************************
+// moves a cache entry to the front of the recently used list. must be called
+// with the lock held.
+static void taa_assetdir_touch_fd(
+    taa_asset_dir_storage* mgr,
+    taa_assetdir_fd* entry)
+{
+    if(mgr->fdhead != entry)
+    {
+        // unlink the entry; it is not the head, so it has a predecessor
+        entry->prev->next = entry->next;
+        if(entry->next != NULL)
+        {
+            entry->next->prev = entry->prev;
         }
         else
         {
-            sz = 0;
+            mgr->fdtail = entry->prev;
         }
-        // queue the data to be processed on another thread
-        buf->sem = &mgr->sem;
-        buf->size = sz;
-        buf->parsefunc = req->parsefunc;
-        buf->userdata = req->userdata;
-        taa_workqueue_push(req->workqueue, taa_assetdir_parse,buf);
-        req = req->next;
+        // insert the entry at the head
+        entry->prev = NULL;
+        entry->next = mgr->fdhead;
+        mgr->fdhead->prev = entry;
+        mgr->fdhead = entry;
     }
 }
 
 //****************************************************************************
-void taa_asset_create_dir_storage(
-    uint32_t maxrequests,
-    taa_asset_dir_storage** mgr_out)
+// returns the cached descriptor of a file and adds a reference to it, or -1
+// if the file does not have a cached descriptor
+static int taa_assetdir_lookup_fd(
+    taa_asset_dir_storage* mgr,
+    taa_assetdir_file* data,
+    taa_assetdir_fd** entry_out)
 {
-    taa_asset_dir_storage* mgr;
-    taa_assetdir_buf* buf;
-    uintptr_t offset;
-    // determine buffer size and pointer offsets
-    offset = 0;
-    mgr = (taa_asset_dir_storage*) offset;
-    offset = (uintptr_t) (mgr + 1);
-    buf = (taa_assetdir_buf*) taa_ALIGN_PTR(offset, 8);
-    offset = (uintptr_t) (buf + maxrequests);
-    // allocate the buffer and adjust pointers
-    offset = (uintptr_t) calloc(1, offset);
-    mgr = (taa_asset_dir_storage*) (((uintptr_t) mgr) + offset);
-    buf = (taa_assetdir_buf*) (((uintptr_t) buf) + offset);
-    // initialize manager struct
-    taa_semaphore_create(&mgr->sem);
-    mgr->buffers = buf;
-    mgr->numbuffers = maxrequests;
-    *mgr_out = mgr;
+    taa_assetdir_fd* entry;
+    int fd = -1;
+    taa_SPINLOCK_LOCK(&mgr->lock);
+    entry = data->fd;
+    if(entry != NULL)
+    {
+        ++entry->refs;
+        taa_assetdir_touch_fd(mgr, entry);
+        fd = entry->fd;
+    }
+    taa_SPINLOCK_UNLOCK(&mgr->lock);
+    *entry_out = entry;
+    return fd;
 }
 
 //****************************************************************************
-void taa_asset_destroy_dir_storage(
-    taa_asset_dir_storage* mgr)
+// adds a newly opened descriptor to the cache in place of the least recently
+// used descriptor that is not being read. returns the descriptor to read the
+// file with, which is the cached one if another thread opened the file
+// first. entry_out is set to the entry holding it, or NULL if it could not
+// be cached, in which case it is closed by taa_assetdir_close_fd.
+static int taa_assetdir_cache_fd(
+    taa_asset_dir_storage* mgr,
+    taa_assetdir_file* data,
+    int fd,
+    taa_assetdir_fd** entry_out)
 {
-    taa_assetdir* dir = mgr->dirs;
-    taa_assetdir_buf* buf = mgr->buffers;
-    taa_assetdir_buf* bufend = buf + mgr->numbuffers;
-    taa_assetdir_strings* strbuf = mgr->stringbuf;
-    taa_semaphore_destroy(&mgr->sem);
-    while(dir != NULL)
+    taa_assetdir_fd** slot = &data->fd;
+    taa_assetdir_fd* entry;
+    int closefd = -1;
+    taa_SPINLOCK_LOCK(&mgr->lock);
+    entry = *slot;
+    if(entry != NULL)
     {
-        taa_assetdir* next = dir->next;
-        free(dir);
-        dir = next;
+        // another thread opened the file first
+        closefd = fd;
+        fd = entry->fd;
     }
-    while(buf != bufend)
+    else
     {
-        free(buf->data);
-        ++buf;
+        entry = mgr->fdtail;
+        while(entry != NULL && entry->refs > 0)
+        {
+            entry = entry->prev;
+        }
+        if(entry != NULL)
+        {
+            if(entry->owner != NULL)
+            {
+                // evict the descriptor of another file
+                *entry->owner = NULL;
+                closefd = entry->fd;
+            }
+            entry->owner = slot;
+            entry->fd = fd;
+            *slot = entry;
+        }
     }
-    while(strbuf != NULL)
+    if(entry != NULL)
     {
-        taa_assetdir_strings* next = strbuf->next;
-        free(strbuf);
-        strbuf = next;
+        ++entry->refs;
+        taa_assetdir_touch_fd(mgr, entry);
     }
-    free(mgr);
+    taa_SPINLOCK_UNLOCK(&mgr->lock);
+    // unlock before calling system functions to avoid stalls
+    if(closefd >= 0)
+    {
+        close(closefd);
+    }
+    *entry_out = entry;
+    return fd;
 }
 
 //****************************************************************************
-taa_asset_group* taa_asset_scan_dir(
+// opens a file relative to its directory, or by its full path if the
+// directory could not be opened
+static int taa_assetdir_openat(
+    taa_assetdir* dir,
+    const taa_assetdir_file* data)
+{
+    int fd;
+    if(dir->dfd >= 0)
+    {
+        fd = openat(dir->dfd, data->name, O_RDONLY | O_CLOEXEC);
+    }
+    else
+    {
+        fd = open(data->path, O_RDONLY | O_CLOEXEC);
+    }
+    return fd;
+}
+
+//****************************************************************************
+// returns a descriptor for reading a file, opening it if it is not cached.
+// returns -1 if the file could not be opened. the descriptor must be given
+// back with taa_assetdir_close_fd.
+static int taa_assetdir_open_fd(
+    taa_assetdir* dir,
+    taa_assetdir_file* data,
+    taa_assetdir_fd** entry_out)
+{
+    int fd = taa_assetdir_lookup_fd(dir->mgr, data, entry_out);
+    if(fd < 0)
+    {
+        fd = taa_assetdir_openat(dir, data);
+        if(fd >= 0)
+        {
+            fd = taa_assetdir_cache_fd(dir->mgr, data, fd, entry_out);
+        }
+    }
+    return fd;
+}
+
+//****************************************************************************
+// releases a descriptor acquired from the cache, or closes it if it was not
+// cached
+static void taa_assetdir_close_fd(
     taa_asset_dir_storage* mgr,
-    const char* name,
-    const char* path)
+    int fd,
+    taa_assetdir_fd* entry)
 {
-    taa_asset_group* group = NULL;
-    uint32_t n = 0;
-    taa_dir sysdir;
-    // loop through and count the files in the directory
-    if(taa_opendir(path, &sysdir) == 0)
+    if(entry != NULL)
     {
-        const char* fname = taa_readdir(sysdir);
-        while(fname != NULL)
+        fd = -1;
+        taa_SPINLOCK_LOCK(&mgr->lock);
+        --entry->refs;
+        if(entry->refs == 0 && entry->owner == NULL)
         {
-            if(strcmp(fname,".") && strcmp(fname, ".."))
-            {
-                struct taa_stat stat;
-                char fpath[taa_PATH_SIZE];
-                // get the full path to the file
-                taa_path_set(fpath, sizeof(fpath), path);
-                taa_path_append(fpath, sizeof(fpath), fname);
-                if(taa_stat(fpath, &stat) == 0)
-                {
-                    if(stat.st_mode == taa_S_IFREG)
-                    {
-                        ++n;
-                    }
-                }
-            }
-            fname = taa_readdir(sysdir);
+            // the file changed while it was being read
+            fd = entry->fd;
+            entry->fd = -1;
         }
-        taa_closedir(sysdir);
+        taa_SPINLOCK_UNLOCK(&mgr->lock);
     }
-    // add the files
-    if(n > 0 && (taa_opendir(path, &sysdir) == 0))
+    if(fd >= 0)
     {
-        uintptr_t offset;
-        taa_assetdir* stordir;
-        taa_asset_file* file;
-        taa_asset_file* fileend;
-        const char* fname;
-        // determine buffer size and pointer offsets
-        offset = 0;
-        stordir = (taa_assetdir*) offset;
-        offset = (uintptr_t) (stordir + 1);
-        file = (taa_asset_file*) offset;
-        offset = (uintptr_t) (file + n);
-        // allocate the buffer and adjust pointers
-        offset = (uintptr_t) malloc(offset);
-        stordir = (taa_assetdir*) (((uintptr_t) stordir) + offset);
-        file = (taa_asset_file*) (((uintptr_t) file) + offset);
-        group = &stordir->group;
-        fileend = file + n;
-        // initialize directory struct and add to manager
-        stordir->mgr = mgr;
-        stordir->next = mgr->dirs;
-        mgr->dirs = stordir;
-        // initialize storage struct
-        group->name = taa_assetdir_strdup(mgr, name);
-        group->key = taa_asset_gen_groupkey(name);
-        group->numfiles = 0;
-        group->files = file;
-        group->loadfunc = taa_assetdir_load;
-        // add files
-        fname = taa_readdir(sysdir);
-        while(file != fileend && fname != NULL)
+        close(fd);
+    }
+}
+
+//****************************************************************************
+// removes the descriptor of a file that has changed from the cache. if it
+// is being read, it is closed once the last read releases it.
+static void taa_assetdir_invalidate_fd(
+    taa_asset_dir_storage* mgr,
+    taa_assetdir_file* data)
+{
+    taa_assetdir_fd* entry;
+    int fd = -1;
+    taa_SPINLOCK_LOCK(&mgr->lock);
+    entry = data->fd;
+    if(entry != NULL)
+    {
+        data->fd = NULL;
+        entry->owner = NULL;
+        if(entry->refs == 0)
         {
-            if(strcmp(fname,".") && strcmp(fname, ".."))
-            {
-                struct taa_stat stat;
-                char fpath[taa_PATH_SIZE];
-                // get the full path to the file
-                taa_path_set(fpath, sizeof(fpath), path);
-                taa_path_append(fpath, sizeof(fpath), fname);
-                if(taa_stat(fpath, &stat) == 0)
-                {
-                    if(stat.st_mode == taa_S_IFREG)
-                    {
-                        uintptr_t h;
-                        h = (uintptr_t) taa_assetdir_strdup(mgr,fpath);
-                        file->name = taa_assetdir_strdup(mgr, fname);
-                        file->typekey=taa_asset_gen_typekey(fname);
-                        file->filekey=taa_asset_gen_filekey(fname);
-                        file->size = stat.st_size;
-                        file->handle = h;
-                        // TODO: check for hash conflicts?
-                        ++file;
-                    }
-                }
-            }
-            fname = taa_readdir(sysdir);
+            fd = entry->fd;
+            entry->fd = -1;
         }
-        taa_closedir(sysdir);
-        group->numfiles = file - group->files;
     }
-    return group;
+    taa_SPINLOCK_UNLOCK(&mgr->lock);
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+#endif // taa_ASSETDIR_FDCACHE
+
+//****************************************************************************
+// called on the storage thread to read the requested range of a single file
+static void taa_assetdir_read(
+    taa_asset_dir_storage* mgr,
+    taa_asset_file_request* req)
+{
+    taa_assetdir_file* data = taa_assetdir_file_data(req->handle);
+    uint32_t sz = req->length;
+    taa_assetdir_buf* buf = taa_assetdir_acquire(mgr, sz, 0, 1);
+#ifdef taa_ASSETDIR_FDCACHE
+    taa_assetdir_fd* entry;
+    int fd = taa_assetdir_open_fd((taa_assetdir*) req->group, data, &entry);
+    unsigned char* dst = (unsigned char*) buf->data;
+    uint32_t remaining = sz;
+    off_t pos = (off_t) req->offset;
+    int ok = (fd >= 0);
+    // pread may return fewer bytes than requested
+    while(ok && remaining > 0)
+    {
+        ssize_t n = pread(fd, dst, remaining, pos);
+        ok = (n > 0);
+        if(ok)
+        {
+            dst += n;
+            pos += n;
+            remaining -= (uint32_t) n;
+        }
+    }
+    taa_assetdir_close_fd(mgr, fd, entry);
+    if(!ok)
+    {
+        sz = 0;
+    }
+#else
+    FILE* fp;
+    // attempt to load the file
+    fp = fopen(data->path, "rb");
+    if(fp != NULL)
+    {
+        if((req->offset != 0 && fseek(fp, req->offset, SEEK_SET) != 0) ||
+           fread(buf->data, 1, sz, fp) != sz)
+        {
+            sz = 0;
+        }
+        fclose(fp);
+    }
+    else
+    {
+        sz = 0;
+    }
+#endif
+    if(sz == 0 && req->length != 0)
+    {
+        // the file could not be read, so the buffer is not needed
+        taa_assetdir_release(buf);
+        taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+    }
+    else
+    {
+        // queue the data to be processed on another thread
+        taa_asset_complete_request(
+            req,
+            buf->data,
+            sz,
+            taa_assetdir_release,
+            buf);
+    }
+}
+
+#ifdef taa_ASSETDIR_MMAP_SUPPORTED
+
+//****************************************************************************
+// called on the storage thread to map the requested range of a single file
+static void taa_assetdir_map(
+    taa_asset_dir_storage* mgr,
+    taa_asset_file_request* req)
+{
+    static const char empty[1] = { 0 };
+    taa_assetdir_file* filedata = taa_assetdir_file_data(req->handle);
+    // mappings must begin on a page boundary
+    uint32_t pagemask = (uint32_t) sysconf(_SC_PAGESIZE) - 1;
+    uint32_t mapoffset = req->offset & ~pagemask;
+    uint32_t skip = req->offset - mapoffset;
+    size_t sz = skip + (size_t) req->length;
+    void* data = MAP_FAILED;
+    taa_assetdir_fd* entry;
+    int fd = taa_assetdir_open_fd(
+        (taa_assetdir*) req->group,
+        filedata,
+        &entry);
+    if(fd >= 0)
+    {
+        struct stat st;
+        // mapping past the end of the file would fault on access, so make
+        // sure it has not been truncated since it was scanned
+        if(req->length > 0 &&
+           fstat(fd, &st) == 0 &&
+           st.st_size >= (off_t) (mapoffset + sz))
+        {
+            // requests that are needed soon are faulted in on the storage
+            // thread so that the parse function does not stall. for less
+            // urgent requests, read ahead is started asynchronously.
+            int populate = req->priority <= taa_ASSET_PRIORITY_VISIBLE;
+            data = mmap(
+                NULL,
+                sz,
+                PROT_READ,
+                MAP_PRIVATE | (populate ? MAP_POPULATE : 0),
+                fd,
+                (off_t) mapoffset);
+            if(data != MAP_FAILED && !populate)
+            {
+                madvise(data, sz, MADV_WILLNEED);
+            }
+        }
+        // the mapping remains valid after the descriptor is closed
+        taa_assetdir_close_fd(mgr, fd, entry);
+    }
+    if(data != MAP_FAILED)
+    {
+        // mappings are charged against the budget like buffers
+        taa_assetdir_buf* buf = taa_assetdir_acquire(mgr, sz, 1, 1);
+        buf->data = data;
+        taa_asset_complete_request(
+            req,
+            ((unsigned char*) data) + skip,
+            req->length,
+            taa_assetdir_release,
+            buf);
+    }
+    else if(fd >= 0 && req->length == 0)
+    {
+        // empty ranges cannot be mapped
+        taa_asset_complete_request(req, empty, 0, NULL, NULL);
+    }
+    else
+    {
+        taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+    }
+}
+
+#endif // taa_ASSETDIR_MMAP_SUPPORTED
+
+//****************************************************************************
+// orders a list of requests by the position of the files on disk with a
+// stable merge sort, so that the disk is swept in a single direction
+static taa_asset_file_request* taa_assetdir_sort(
+    taa_asset_file_request* requests)
+{
+    taa_asset_file_request* sorted = requests;
+    if(requests != NULL && requests->next != NULL)
+    {
+        taa_asset_file_request* a = requests;
+        taa_asset_file_request* b;
+        taa_asset_file_request* mid = requests;
+        taa_asset_file_request* fast = requests->next;
+        taa_asset_file_request** tail = &sorted;
+        // split the list in half and sort each half
+        while(fast != NULL && fast->next != NULL)
+        {
+            mid = mid->next;
+            fast = fast->next->next;
+        }
+        b = mid->next;
+        mid->next = NULL;
+        a = taa_assetdir_sort(a);
+        b = taa_assetdir_sort(b);
+        // merge the halves, taking from the first half on ties
+        while(a != NULL && b != NULL)
+        {
+            uint64_t akey = taa_assetdir_file_data(a->handle)->sortkey;
+            uint64_t bkey = taa_assetdir_file_data(b->handle)->sortkey;
+            if(bkey < akey)
+            {
+                *tail = b;
+                b = b->next;
+            }
+            else
+            {
+                *tail = a;
+                a = a->next;
+            }
+            tail = &(*tail)->next;
+        }
+        *tail = (a != NULL) ? a : b;
+    }
+    return sorted;
+}
+
+#ifdef taa_ASSETDIR_URING
+
+//****************************************************************************
+static void taa_assetdir_destroy_ring(
+    taa_assetdir_ring* ring)
+{
+    if(ring->sqes != NULL)
+    {
+        munmap(ring->sqes, ring->sqesize);
+    }
+    if(ring->cqmem != NULL && ring->cqmem != ring->sqmem)
+    {
+        munmap(ring->cqmem, ring->cqsize);
+    }
+    if(ring->sqmem != NULL)
+    {
+        munmap(ring->sqmem, ring->sqsize);
+    }
+    if(ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+    free(ring);
+}
+
+//****************************************************************************
+// returns true if the kernel supports the operations used to load files.
+// io_uring itself is older than the open and read operations, which would
+// otherwise fail every request on kernels that lack them.
+static int taa_assetdir_probe_ring(
+    int fd)
+{
+    struct io_uring_probe* probe;
+    size_t size = sizeof(*probe) + 256*sizeof(struct io_uring_probe_op);
+    int result;
+    int ok = 0;
+    probe = (struct io_uring_probe*) calloc(1, size);
+    result = (int) syscall(
+        __NR_io_uring_register,
+        fd,
+        IORING_REGISTER_PROBE,
+        probe,
+        256);
+    if(result >= 0)
+    {
+        ok = probe->last_op >= IORING_OP_OPENAT &&
+             probe->last_op >= IORING_OP_READ &&
+             (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+             (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+//****************************************************************************
+// creates an io_uring instance. returns NULL if io_uring is unavailable.
+static taa_assetdir_ring* taa_assetdir_create_ring()
+{
+    taa_assetdir_ring* ring;
+    struct io_uring_params params;
+    int ok = 0;
+    ring = (taa_assetdir_ring*) calloc(1, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int) syscall(
+        __NR_io_uring_setup,
+        taa_ASSETDIR_RING_DEPTH,
+        &params);
+    if(ring->fd >= 0)
+    {
+        unsigned char* sq;
+        unsigned char* cq;
+        ring->sqsize = params.sq_off.array +
+            params.sq_entries * sizeof(uint32_t);
+        ring->cqsize = params.cq_off.cqes +
+            params.cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqesize = params.sq_entries * sizeof(struct io_uring_sqe);
+        if((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+        {
+            // the submission and completion rings share a mapping
+            if(ring->cqsize > ring->sqsize)
+            {
+                ring->sqsize = ring->cqsize;
+            }
+            ring->cqsize = ring->sqsize;
+        }
+        sq = (unsigned char*) mmap(
+            NULL,
+            ring->sqsize,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            ring->fd,
+            IORING_OFF_SQ_RING);
+        cq = sq;
+        if(sq != MAP_FAILED)
+        {
+            ring->sqmem = sq;
+            if((params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+            {
+                cq = (unsigned char*) mmap(
+                    NULL,
+                    ring->cqsize,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE,
+                    ring->fd,
+                    IORING_OFF_CQ_RING);
+            }
+        }
+        if(sq != MAP_FAILED && cq != MAP_FAILED)
+        {
+            void* sqes;
+            ring->cqmem = cq;
+            sqes = mmap(
+                NULL,
+                ring->sqesize,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                ring->fd,
+                IORING_OFF_SQES);
+            if(sqes != MAP_FAILED)
+            {
+                ring->sqes = (struct io_uring_sqe*) sqes;
+                ring->sqhead = (uint32_t*) (sq + params.sq_off.head);
+                ring->sqtail = (uint32_t*) (sq + params.sq_off.tail);
+                ring->sqmask = *(uint32_t*) (sq + params.sq_off.ring_mask);
+                ring->sqarray = (uint32_t*) (sq + params.sq_off.array);
+                ring->cqhead = (uint32_t*) (cq + params.cq_off.head);
+                ring->cqtail = (uint32_t*) (cq + params.cq_off.tail);
+                ring->cqmask = *(uint32_t*) (cq + params.cq_off.ring_mask);
+                ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+                ok = taa_assetdir_probe_ring(ring->fd);
+            }
+        }
+    }
+    if(!ok)
+    {
+        taa_assetdir_destroy_ring(ring);
+        ring = NULL;
+    }
+    return ring;
+}
+
+//****************************************************************************
+// fills the next submission queue entry. the entry is not submitted until
+// taa_assetdir_ring_wait is called.
+static void taa_assetdir_ring_push(
+    taa_assetdir_ring* ring,
+    uint8_t opcode,
+    int fd,
+    const void* addr,
+    uint32_t len,
+    uint64_t off,
+    uint32_t flags,
+    uint32_t slot)
+{
+    uint32_t tail = *ring->sqtail;
+    uint32_t index = tail & ring->sqmask;
+    struct io_uring_sqe* sqe = ring->sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->open_flags = flags;
+    sqe->user_data = slot;
+    ring->sqarray[index] = index;
+    // publish the entry to the kernel
+    __atomic_store_n(ring->sqtail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->numpending;
+}
+
+//****************************************************************************
+// submits pending entries and waits for at least one completion
+static void taa_assetdir_ring_wait(
+    taa_assetdir_ring* ring)
+{
+    int result;
+    do
+    {
+        result = (int) syscall(
+            __NR_io_uring_enter,
+            ring->fd,
+            ring->numpending,
+            1,
+            IORING_ENTER_GETEVENTS,
+            NULL,
+            0);
+    }
+    while(result < 0 && errno == EINTR);
+    if(result > 0)
+    {
+        ring->numpending -= result;
+    }
+}
+
+//****************************************************************************
+// hands the data of a finished slot to the storage and frees the slot
+static void taa_assetdir_ring_finish(
+    taa_assetdir_slot* slot,
+    int ok)
+{
+    taa_asset_file_request* req = slot->req;
+    taa_assetdir_close_fd(slot->buf->mgr, slot->fd, slot->entry);
+    if(ok)
+    {
+        taa_asset_complete_request(
+            req,
+            slot->buf->data,
+            slot->offset,
+            taa_assetdir_release,
+            slot->buf);
+    }
+    else
+    {
+        taa_assetdir_release(slot->buf);
+        taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+    }
+    slot->state = taa_ASSETDIR_SLOT_FREE;
+    slot->fd = -1;
+    slot->entry = NULL;
+}
+
+//****************************************************************************
+// processes an operation that has completed for a slot. returns true if the
+// request is finished and the slot is free.
+static int taa_assetdir_ring_advance(
+    taa_assetdir_ring* ring,
+    uint32_t index,
+    int32_t res)
+{
+    taa_assetdir_slot* slot = ring->slots + index;
+    uint32_t size = slot->req->length;
+    int done = 0;
+    if(res < 0)
+    {
+        // the open or read failed
+        taa_assetdir_ring_finish(slot, 0);
+        done = 1;
+    }
+    else if(slot->state == taa_ASSETDIR_SLOT_OPENING)
+    {
+        // keep the descriptor open for later requests for the file
+        slot->fd = taa_assetdir_cache_fd(
+            slot->buf->mgr,
+            taa_assetdir_file_data(slot->req->handle),
+            res,
+            &slot->entry);
+        slot->state = taa_ASSETDIR_SLOT_READING;
+    }
+    else if(res == 0 && slot->offset < size)
+    {
+        // the file is shorter than when it was scanned
+        taa_assetdir_ring_finish(slot, 0);
+        done = 1;
+    }
+    else
+    {
+        slot->offset += res;
+    }
+    if(!done && slot->offset == size)
+    {
+        taa_assetdir_ring_finish(slot, 1);
+        done = 1;
+    }
+    else if(!done)
+    {
+        // read the file, or the remainder after a short read
+        taa_assetdir_ring_push(
+            ring,
+            IORING_OP_READ,
+            slot->fd,
+            ((unsigned char*) slot->buf->data) + slot->offset,
+            size - slot->offset,
+            slot->req->offset + (uint64_t) slot->offset,
+            0,
+            index);
+    }
+    return done;
+}
+
+//****************************************************************************
+// loads a set of requests with every available buffer in flight at once. as
+// the list runs out, further requests for the group are taken from the
+// storage so that the ring does not drain between lists.
+static void taa_assetdir_ring_load(
+    taa_asset_dir_storage* mgr,
+    taa_assetdir_ring* ring,
+    taa_asset_file_request* requests)
+{
+    taa_asset_storage* storage = requests->storage;
+    taa_asset_group* group = requests->group;
+    taa_asset_file_request* req = requests;
+    uint32_t numinflight = 0;
+    int refill = 1;
+    while(req != NULL || numinflight > 0)
+    {
+        taa_assetdir_slot* slot = ring->slots;
+        taa_assetdir_slot* slotend = slot + taa_ASSETDIR_RING_DEPTH;
+        uint32_t head;
+        uint32_t tail;
+        // start opening as many files as there are slots and buffers
+        while(req != NULL && slot != slotend)
+        {
+            if(slot->state != taa_ASSETDIR_SLOT_FREE)
+            {
+                ++slot;
+            }
+            else if(taa_asset_is_request_cancelled(req))
+            {
+                // the data is no longer needed, so don't bother reading it
+                taa_asset_file_request* next = req->next;
+                taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+                req = next;
+            }
+            else
+            {
+                // if nothing is in flight, nothing can release a buffer
+                // before one is claimed, so it is safe to wait for one
+                int wait = (numinflight == 0);
+                uint32_t sz = req->length;
+                taa_assetdir_buf* buf;
+                buf = taa_assetdir_acquire(mgr, sz, 0, wait);
+                if(buf == NULL)
+                {
+                    // wait for outstanding reads to finish
+                    slot = slotend;
+                }
+                else
+                {
+                    taa_assetdir* dir = (taa_assetdir*) req->group;
+                    taa_assetdir_file* data;
+                    uint32_t index = (uint32_t) (slot - ring->slots);
+                    data = taa_assetdir_file_data(req->handle);
+                    slot->req = req;
+                    slot->buf = buf;
+                    slot->offset = 0;
+                    slot->fd = taa_assetdir_lookup_fd(
+                        mgr,
+                        data,
+                        &slot->entry);
+                    req = req->next;
+                    if(slot->fd >= 0)
+                    {
+                        // the file is already open, so read it right away
+                        slot->state = taa_ASSETDIR_SLOT_READING;
+                        taa_assetdir_ring_push(
+                            ring,
+                            IORING_OP_READ,
+                            slot->fd,
+                            buf->data,
+                            slot->req->length,
+                            slot->req->offset,
+                            0,
+                            index);
+                    }
+                    else if(dir->dfd >= 0)
+                    {
+                        slot->state = taa_ASSETDIR_SLOT_OPENING;
+                        taa_assetdir_ring_push(
+                            ring,
+                            IORING_OP_OPENAT,
+                            dir->dfd,
+                            data->name,
+                            0,
+                            0,
+                            O_RDONLY | O_CLOEXEC,
+                            index);
+                    }
+                    else
+                    {
+                        slot->state = taa_ASSETDIR_SLOT_OPENING;
+                        taa_assetdir_ring_push(
+                            ring,
+                            IORING_OP_OPENAT,
+                            AT_FDCWD,
+                            data->path,
+                            0,
+                            0,
+                            O_RDONLY | O_CLOEXEC,
+                            index);
+                    }
+                    ++numinflight;
+                }
+            }
+        }
+        if(numinflight > 0)
+        {
+            taa_assetdir_ring_wait(ring);
+            // process every available completion
+            head = *ring->cqhead;
+            tail = __atomic_load_n(ring->cqtail, __ATOMIC_ACQUIRE);
+            while(head != tail)
+            {
+                struct io_uring_cqe* cqe = ring->cqes + (head & ring->cqmask);
+                uint32_t index = (uint32_t) cqe->user_data;
+                if(taa_assetdir_ring_advance(ring, index, cqe->res))
+                {
+                    --numinflight;
+                }
+                ++head;
+            }
+            __atomic_store_n(ring->cqhead, head, __ATOMIC_RELEASE);
+        }
+        if(req == NULL && refill && numinflight < taa_ASSETDIR_RING_DEPTH)
+        {
+            // stop asking once the storage has nothing more to give, so
+            // that the thread returns to the scheduler
+            req = taa_asset_refill_requests(storage, group);
+            req = taa_assetdir_sort(req);
+            refill = (req != NULL);
+        }
+    }
+}
+
+#endif // taa_ASSETDIR_URING
+
+//****************************************************************************
+// called on the storage thread to load the contents of a set of files. the
+// requests are sorted by the position of the files on disk first.
+static void taa_assetdir_load(
+    taa_asset_group* group,
+    taa_asset_file_request* requests)
+{
+    taa_assetdir* dir = (taa_assetdir*) group;
+    taa_asset_dir_storage* mgr = dir->mgr;
+    taa_asset_file_request* req = taa_assetdir_sort(requests);
+#ifdef taa_ASSETDIR_URING
+    taa_assetdir_ring* ring = NULL;
+#endif
+#ifdef taa_ASSETDIR_MMAP_SUPPORTED
+    if((mgr->flags & taa_ASSETDIR_MMAP) != 0)
+    {
+        while(req != NULL)
+        {
+            // the request may be released once it is completed
+            taa_asset_file_request* next = req->next;
+            if(!taa_asset_is_request_cancelled(req))
+            {
+                taa_assetdir_map(mgr, req);
+            }
+            else
+            {
+                taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+            }
+            req = next;
+        }
+    }
+#endif
+#ifdef taa_ASSETDIR_URING
+    if(req != NULL && !mgr->nouring)
+    {
+        // claim a ring that is not being used by another storage thread
+        taa_SPINLOCK_LOCK(&mgr->lock);
+        ring = mgr->rings;
+        while(ring != NULL && ring->inuse)
+        {
+            ring = ring->next;
+        }
+        if(ring != NULL)
+        {
+            ring->inuse = 1;
+        }
+        taa_SPINLOCK_UNLOCK(&mgr->lock);
+        if(ring == NULL)
+        {
+            // unlock before calling system functions to avoid stalls
+            ring = taa_assetdir_create_ring();
+            if(ring != NULL)
+            {
+                ring->inuse = 1;
+                taa_SPINLOCK_LOCK(&mgr->lock);
+                ring->next = mgr->rings;
+                mgr->rings = ring;
+                taa_SPINLOCK_UNLOCK(&mgr->lock);
+            }
+            else
+            {
+                taa_LOG_WARN("io_uring unavailable, using blocking reads");
+                mgr->nouring = 1;
+            }
+        }
+    }
+    if(ring != NULL)
+    {
+        taa_assetdir_ring_load(mgr, ring, req);
+        taa_SPINLOCK_LOCK(&mgr->lock);
+        ring->inuse = 0;
+        taa_SPINLOCK_UNLOCK(&mgr->lock);
+        req = NULL;
+    }
+#endif
+    while(req != NULL)
+    {
+        // the request may be released once it is completed
+        taa_asset_file_request* next = req->next;
+        if(!taa_asset_is_request_cancelled(req))
+        {
+            taa_assetdir_read(mgr, req);
+        }
+        else
+        {
+            // the data is no longer needed, so don't bother reading it
+            taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+        }
+        req = next;
+    }
+}
+
+//****************************************************************************
+void taa_asset_create_dir_storage(
+    size_t budget,
+    uint32_t maxfds,
+    uint32_t flags,
+    taa_asset_dir_storage** mgr_out)
+{
+    taa_asset_dir_storage* mgr;
+#ifdef taa_ASSETDIR_FDCACHE
+    struct rlimit rl;
+    uint32_t i;
+#endif
+    mgr = (taa_asset_dir_storage*) calloc(1, sizeof(*mgr));
+    // initialize manager struct
+    taa_semaphore_create(&mgr->sem);
+    mgr->budget = budget;
+    mgr->flags = flags;
+#ifdef taa_ASSETDIR_FDCACHE
+    // leave at least half of the process descriptor limit to the rest of
+    // the application
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+       rl.rlim_cur != RLIM_INFINITY &&
+       maxfds > rl.rlim_cur / 2)
+    {
+        maxfds = (uint32_t) (rl.rlim_cur / 2);
+    }
+    if(maxfds > 0)
+    {
+        mgr->fds = (taa_assetdir_fd*) calloc(maxfds, sizeof(*mgr->fds));
+        for(i = 0; i < maxfds; ++i)
+        {
+            mgr->fds[i].fd = -1;
+            mgr->fds[i].prev = (i > 0) ? mgr->fds + i - 1 : NULL;
+            mgr->fds[i].next = (i + 1 < maxfds) ? mgr->fds + i + 1 : NULL;
+        }
+        mgr->fdhead = mgr->fds;
+        mgr->fdtail = mgr->fds + maxfds - 1;
+    }
+#else
+    // files are opened for each read when descriptors are not cached
+    (void) maxfds;
+#endif
+#ifdef taa_ASSETDIR_INOTIFY
+    mgr->inotifyfd = -1;
+#endif
+    *mgr_out = mgr;
+}
+
+//****************************************************************************
+// frees a group along with its file tables, storage data and names. the
+// descriptors of its files must already have been closed.
+static void taa_assetdir_free(
+    taa_assetdir* dir)
+{
+    taa_assetdir_strings* strbuf = dir->strings;
+#ifdef taa_ASSETDIR_INOTIFY
+    taa_assetdir_table* table = dir->tables;
+    taa_assetdir_file* data = dir->files;
+    while(table != NULL)
+    {
+        taa_assetdir_table* next = table->next;
+        free(table);
+        table = next;
+    }
+    while(data != NULL)
+    {
+        taa_assetdir_file* next = data->next;
+        free(data);
+        data = next;
+    }
+#endif
+#ifdef taa_ASSETDIR_FDCACHE
+    if(dir->dfd >= 0)
+    {
+        close(dir->dfd);
+    }
+#endif
+    while(strbuf != NULL)
+    {
+        taa_assetdir_strings* next = strbuf->next;
+        free(strbuf);
+        strbuf = next;
+    }
+    free(dir);
+}
+
+//****************************************************************************
+void taa_asset_destroy_dir_storage(
+    taa_asset_dir_storage* mgr)
+{
+    taa_assetdir* dir = mgr->dirs;
+    taa_assetdir_buf* buf;
+#ifdef taa_ASSETDIR_FDCACHE
+    taa_assetdir_fd* entry;
+#endif
+#ifdef taa_ASSETDIR_URING
+    taa_assetdir_ring* ring = mgr->rings;
+    while(ring != NULL)
+    {
+        taa_assetdir_ring* next = ring->next;
+        taa_assetdir_destroy_ring(ring);
+        ring = next;
+    }
+#endif
+    taa_semaphore_destroy(&mgr->sem);
+    while(dir != NULL)
+    {
+        taa_assetdir* next = dir->next;
+        taa_assetdir_free(dir);
+        dir = next;
+    }
+#ifdef taa_ASSETDIR_INOTIFY
+    if(mgr->inotifyfd >= 0)
+    {
+        // closing the instance removes its watches
+        close(mgr->inotifyfd);
+    }
+#endif
+#ifdef taa_ASSETDIR_FDCACHE
+    entry = mgr->fdhead;
+    while(entry != NULL)
+    {
+        if(entry->owner != NULL)
+        {
+            close(entry->fd);
+        }
+        entry = entry->next;
+    }
+    free(mgr->fds);
+#endif
+    // every buffer must have been released by now
+    buf = taa_assetdir_evict(mgr, 0);
+    while(buf != NULL)
+    {
+        taa_assetdir_buf* next = buf->next;
+        free(buf);
+        buf = next;
+    }
+    buf = mgr->freemaps;
+    while(buf != NULL)
+    {
+        taa_assetdir_buf* next = buf->next;
+        free(buf);
+        buf = next;
+    }
+    free(mgr);
+}
+
+//****************************************************************************
+void taa_asset_release_dir_group(
+    taa_asset_dir_storage* mgr,
+    taa_asset_group* group)
+{
+    taa_assetdir* dir = (taa_assetdir*) group;
+    taa_assetdir** link = &mgr->dirs;
+#ifdef taa_ASSETDIR_FDCACHE
+    uint32_t i;
+#endif
+    while(*link != dir)
+    {
+        link = &(*link)->next;
+    }
+    *link = dir->next;
+#ifdef taa_ASSETDIR_INOTIFY
+    if(dir->wd >= 0)
+    {
+        // groups of the same directory share a watch, which is only removed
+        // with the last of them
+        taa_assetdir* other = mgr->dirs;
+        while(other != NULL && other->wd != dir->wd)
+        {
+            other = other->next;
+        }
+        if(other == NULL)
+        {
+            inotify_rm_watch(mgr->inotifyfd, dir->wd);
+        }
+    }
+#endif
+#ifdef taa_ASSETDIR_FDCACHE
+    // replaced storage data was already removed from the cache when its
+    // file changed, so only the current files can have descriptors
+    for(i = 0; i < group->numfiles; ++i)
+    {
+        taa_assetdir_invalidate_fd(
+            mgr,
+            taa_assetdir_file_data(group->files[i].handle));
+    }
+#endif
+    taa_assetdir_free(dir);
+}
+
+//****************************************************************************
+void taa_asset_trim_dir_storage(
+    taa_asset_dir_storage* mgr,
+    size_t maxcached)
+{
+    taa_assetdir_buf* buf;
+    taa_SPINLOCK_LOCK(&mgr->lock);
+    buf = taa_assetdir_evict(mgr, maxcached);
+    taa_SPINLOCK_UNLOCK(&mgr->lock);
+    while(buf != NULL)
+    {
+        // free evicted buffers after lock is released
+        taa_assetdir_buf* next = buf->next;
+        free(buf);
+        buf = next;
+    }
+}
+
+//****************************************************************************
+// appends a file to the scan results, growing the arrays geometrically
+static void taa_assetdir_scan_add(
+    taa_assetdir_scan* scan,
+    const char* fname,
+    uint32_t size,
+    uint64_t sortkey)
+{
+    uint32_t len = strlen(fname) + 1;
+    taa_assetdir_scan_entry* entry;
+    if(scan->numentries == scan->entrycapacity)
+    {
+        uint32_t cap = scan->entrycapacity;
+        cap = (cap > 0) ? cap * 2 : 256;
+        scan->entries = (taa_assetdir_scan_entry*) realloc(
+            scan->entries,
+            cap * sizeof(*scan->entries));
+        scan->entrycapacity = cap;
+    }
+    if(scan->namessize + len > scan->namescapacity)
+    {
+        uint32_t cap = scan->namescapacity;
+        cap = (cap > 0) ? cap : 4096;
+        while(scan->namessize + len > cap)
+        {
+            cap *= 2;
+        }
+        scan->names = (char*) realloc(scan->names, cap);
+        scan->namescapacity = cap;
+    }
+    entry = scan->entries + scan->numentries;
+    entry->sortkey = sortkey;
+    entry->nameoffset = scan->namessize;
+    entry->size = size;
+    entry->typekey = taa_asset_gen_typekey(fname);
+    entry->filekey = taa_asset_gen_filekey(fname);
+    memcpy(scan->names + scan->namessize, fname, len);
+    scan->namessize += len;
+    ++scan->numentries;
+}
+
+#ifdef taa_ASSETDIR_GETDENTS
+
+//****************************************************************************
+// returns the physical offset on disk of the start of a file, or zero if
+// the file has no data on disk. if the file system can not report the
+// layout of files, the inode number is returned instead.
+static uint64_t taa_assetdir_physical(
+    int dfd,
+    const char* fname,
+    uint64_t ino)
+{
+    uint64_t result = ino;
+    int fd = openat(dfd, fname, O_RDONLY | O_CLOEXEC);
+    if(fd >= 0)
+    {
+        // room for the header and a single extent
+        uint64_t buf[
+            (sizeof(struct fiemap) + sizeof(struct fiemap_extent) + 7) / 8];
+        struct fiemap* fm = (struct fiemap*) buf;
+        memset(buf, 0, sizeof(buf));
+        fm->fm_start = 0;
+        fm->fm_length = FIEMAP_MAX_OFFSET;
+        fm->fm_extent_count = 1;
+        if(ioctl(fd, FS_IOC_FIEMAP, fm) == 0)
+        {
+            result = 0;
+            if(fm->fm_mapped_extents > 0)
+            {
+                result = fm->fm_extents[0].fe_physical;
+            }
+        }
+        close(fd);
+    }
+    return result;
+}
+
+//****************************************************************************
+// reads the regular files in a directory. entries are read in large blocks
+// with getdents64, and only those whose type is not known to be something
+// other than a regular file are passed to fstatat relative to the directory.
+// files are ordered on disk by inode number, or by their physical offset if
+// the taa_ASSETDIR_FIEMAP flag is set.
+static void taa_assetdir_scan_entries(
+    const char* path,
+    uint32_t flags,
+    taa_assetdir_scan* scan)
+{
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dfd >= 0)
+    {
+        // 64 bit elements keep the records suitably aligned
+        uint64_t buf[4096];
+        long n = syscall(SYS_getdents64, dfd, buf, sizeof(buf));
+        while(n > 0)
+        {
+            unsigned char* itr = (unsigned char*) buf;
+            unsigned char* end = itr + n;
+            while(itr != end)
+            {
+                taa_assetdir_dirent64* d = (taa_assetdir_dirent64*) itr;
+                const char* fname = d->d_name;
+                unsigned char type = d->d_type;
+                // links and file systems that do not report the type must
+                // be checked with stat
+                if(type == DT_REG || type == DT_LNK || type == DT_UNKNOWN)
+                {
+                    struct stat st;
+                    if(strcmp(fname,".") && strcmp(fname, "..") &&
+                       fstatat(dfd, fname, &st, 0) == 0 &&
+                       S_ISREG(st.st_mode))
+                    {
+                        uint64_t sortkey = (uint64_t) st.st_ino;
+                        if((flags & taa_ASSETDIR_FIEMAP) != 0)
+                        {
+                            sortkey = taa_assetdir_physical(
+                                dfd,
+                                fname,
+                                sortkey);
+                        }
+                        taa_assetdir_scan_add(
+                            scan,
+                            fname,
+                            st.st_size,
+                            sortkey);
+                    }
+                }
+                itr += d->d_reclen;
+            }
+            n = syscall(SYS_getdents64, dfd, buf, sizeof(buf));
+        }
+        close(dfd);
+    }
+}
+
+#else
+
+//****************************************************************************
+// reads the regular files in a directory in a single pass. the position of
+// files on disk is not known, so they are read in directory order.
+static void taa_assetdir_scan_entries(
+    const char* path,
+    uint32_t flags,
+    taa_assetdir_scan* scan)
+{
+    taa_dir sysdir;
+    // the disk position of files is not known, so no ordering flag applies
+    (void) flags;
+    if(taa_opendir(path, &sysdir) == 0)
+    {
+        const char* fname = taa_readdir(sysdir);
+        while(fname != NULL)
+        {
+            if(strcmp(fname,".") && strcmp(fname, ".."))
+            {
+                struct taa_stat stat;
+                char fpath[taa_PATH_SIZE];
+                // get the full path to the file
+                taa_path_set(fpath, sizeof(fpath), path);
+                taa_path_append(fpath, sizeof(fpath), fname);
+                if(taa_stat(fpath, &stat) == 0)
+                {
+                    if(stat.st_mode == taa_S_IFREG)
+                    {
+                        taa_assetdir_scan_add(scan, fname, stat.st_size, 0);
+                    }
+                }
+            }
+            fname = taa_readdir(sysdir);
+        }
+        taa_closedir(sysdir);
+    }
+}
+
+#endif // taa_ASSETDIR_GETDENTS
+
+//****************************************************************************
+// fills in the fingerprint fields of a manifest header from the attributes of
+// a directory. any file that is added, removed, or renamed in the directory
+// changes its modification time. returns zero if the directory could not be
+// fingerprinted, in which case no manifest may be used.
+static int taa_assetdir_fingerprint(
+    const char* path,
+    taa_assetdir_manifest* header)
+{
+    int result = 0;
+#ifdef __linux__
+    struct stat st;
+    if(stat(path, &st) == 0)
+    {
+        header->dev = (uint64_t) st.st_dev;
+        header->ino = (uint64_t) st.st_ino;
+        header->mtimesec = (int64_t) st.st_mtim.tv_sec;
+        header->mtimensec = (int64_t) st.st_mtim.tv_nsec;
+        result = 1;
+    }
+#else
+    // without a modification time the directory is always scanned
+    (void) path;
+    (void) header;
+#endif
+    return result;
+}
+
+//****************************************************************************
+// reads the scan results from a manifest if it matches the fingerprint. the
+// entries and names are read into a single buffer owned by scan->entries.
+// returns zero if the manifest is missing, stale, or malformed.
+static int taa_assetdir_read_manifest(
+    const char* manifestpath,
+    const taa_assetdir_manifest* fingerprint,
+    taa_assetdir_scan* scan)
+{
+    int result = 0;
+    FILE* fp = fopen(manifestpath, "rb");
+    if(fp != NULL)
+    {
+        taa_assetdir_manifest header;
+        if(fread(&header, sizeof(header), 1, fp) == 1 &&
+           header.magic == taa_ASSETDIR_MANIFEST_MAGIC &&
+           header.version == taa_ASSETDIR_MANIFEST_VERSION &&
+           header.dev == fingerprint->dev &&
+           header.ino == fingerprint->ino &&
+           header.mtimesec == fingerprint->mtimesec &&
+           header.mtimensec == fingerprint->mtimensec &&
+           header.flags == fingerprint->flags &&
+           header.numentries > 0 &&
+           header.namessize > 0 &&
+           header.numentries <= 0x7fffffff / sizeof(*scan->entries))
+        {
+            size_t entriessize = header.numentries * sizeof(*scan->entries);
+            size_t size = entriessize + header.namessize;
+            unsigned char* buf = (unsigned char*) malloc(size);
+            // the rest of the file is read with a single call
+            if(fread(buf, 1, size, fp) == size)
+            {
+                taa_assetdir_scan_entry* entry;
+                taa_assetdir_scan_entry* entryend;
+                scan->entries = (taa_assetdir_scan_entry*) buf;
+                scan->numentries = header.numentries;
+                scan->names = (char*) (buf + entriessize);
+                scan->namessize = header.namessize;
+                result = (scan->names[scan->namessize - 1] == '\0');
+                entry = scan->entries;
+                entryend = entry + scan->numentries;
+                while(entry != entryend)
+                {
+                    if(entry->nameoffset >= scan->namessize)
+                    {
+                        result = 0;
+                    }
+                    ++entry;
+                }
+            }
+            if(!result)
+            {
+                memset(scan, 0, sizeof(*scan));
+                free(buf);
+            }
+        }
+        fclose(fp);
+    }
+    return result;
+}
+
+//****************************************************************************
+// writes the scan results to a manifest with the specified fingerprint
+static void taa_assetdir_write_manifest(
+    const char* manifestpath,
+    const taa_assetdir_manifest* fingerprint,
+    const taa_assetdir_scan* scan)
+{
+    FILE* fp = fopen(manifestpath, "wb");
+    if(fp != NULL)
+    {
+        taa_assetdir_manifest header = *fingerprint;
+        size_t n = scan->numentries;
+        int err = 0;
+        header.magic = taa_ASSETDIR_MANIFEST_MAGIC;
+        header.version = taa_ASSETDIR_MANIFEST_VERSION;
+        header.numentries = scan->numentries;
+        header.namessize = scan->namessize;
+        err |= fwrite(&header, sizeof(header), 1, fp) != 1;
+        err |= fwrite(scan->entries, sizeof(*scan->entries), n, fp) != n;
+        err |= fwrite(scan->names, 1, scan->namessize, fp)!=scan->namessize;
+        err |= fclose(fp) != 0;
+        if(err)
+        {
+            // do not leave a partial manifest behind
+            taa_LOG_WARN("failed to write asset manifest %s", manifestpath);
+            remove(manifestpath);
+        }
+    }
+}
+
+//****************************************************************************
+// orders records of a key in the upper half and a file index in the lower
+static int taa_assetdir_compare_records(
+    const void* a,
+    const void* b)
+{
+    uint64_t ra = *((const uint64_t*) a);
+    uint64_t rb = *((const uint64_t*) b);
+    return (ra < rb) ? -1 : ((ra > rb) ? 1 : 0);
+}
+
+//****************************************************************************
+// sorts records of a key and the index of the file it belongs to, so that
+// the files with the same key are adjacent
+static void taa_assetdir_sort_keys(
+    const taa_asset_group* group,
+    int typekeys,
+    uint64_t* records)
+{
+    const taa_asset_file* file = group->files;
+    uint32_t i;
+    for(i = 0; i < group->numfiles; ++i)
+    {
+        uint64_t k = typekeys ? file->typekey : file->filekey;
+        records[i] = (k << 32) | i;
+        ++file;
+    }
+    qsort(
+        records,
+        group->numfiles,
+        sizeof(*records),
+        taa_assetdir_compare_records);
+}
+
+//****************************************************************************
+// reports the files of a group whose file or type keys are the same as those
+// of another file with a different name or extension. when keys collide,
+// only one of the files can be found by its key.
+static void taa_assetdir_check_keys(
+    const taa_asset_group* group)
+{
+    const taa_asset_file* files = group->files;
+    uint32_t n = group->numfiles;
+    uint64_t* records = (uint64_t*) malloc(n * sizeof(*records) + 1);
+    uint32_t first;
+    uint32_t other;
+    uint32_t i;
+    uint32_t j;
+    // files with the same file key are a single name with a few different
+    // extensions, so each is compared with all the others
+    taa_assetdir_sort_keys(group, 0, records);
+    first = 0;
+    for(i = 1; i < n; ++i)
+    {
+        const char* name = files[(uint32_t) records[i]].name;
+        if((records[i] >> 32) != (records[first] >> 32))
+        {
+            first = i;
+        }
+        for(j = first; j < i; ++j)
+        {
+            const char* prev = files[(uint32_t) records[j]].name;
+            if(!taa_asset_same_file_stem(prev, name))
+            {
+                taa_LOG_WARN(
+                    "asset key collision in %s: %s and %s",
+                    group->name,
+                    prev,
+                    name);
+            }
+        }
+    }
+    // files with the same type key may be most of the group, so each is
+    // only compared with the first file of the type and with the last
+    // file that was reported, which reports each extension once
+    taa_assetdir_sort_keys(group, 1, records);
+    first = 0;
+    other = 0;
+    for(i = 1; i < n; ++i)
+    {
+        const char* name = files[(uint32_t) records[i]].name;
+        if((records[i] >> 32) != (records[first] >> 32))
+        {
+            first = i;
+            other = i;
+        }
+        if(!taa_asset_same_file_ext(
+               files[(uint32_t) records[first]].name,
+               name) &&
+           (other == first ||
+            !taa_asset_same_file_ext(
+               files[(uint32_t) records[other]].name,
+               name)))
+        {
+            taa_LOG_WARN(
+                "asset type key collision in %s: %s and %s",
+                group->name,
+                files[(uint32_t) records[first]].name,
+                name);
+            other = i;
+        }
+    }
+    free(records);
+}
+
+//****************************************************************************
+// creates a storage group from the results of a directory scan. the group,
+// its file table, the file names, and the storage data of the files are
+// allocated in a single buffer.
+static taa_asset_group* taa_assetdir_create_group(
+    taa_asset_dir_storage* mgr,
+    const char* name,
+    const char* path,
+    const taa_assetdir_scan* scan)
+{
+    taa_asset_group* group = NULL;
+    uint32_t n = scan->numentries;
+    if(n > 0)
+    {
+        uintptr_t offset;
+        taa_assetdir* stordir;
+        taa_asset_file* file;
+        taa_asset_file* fileend;
+        char* names;
+        char* data;
+        const taa_assetdir_scan_entry* entry;
+        // determine buffer size and pointer offsets. the storage data of
+        // each file is padded for alignment, and each path is at most the
+        // directory, a separator, and the file name.
+        offset = 0;
+        stordir = (taa_assetdir*) offset;
+        offset = (uintptr_t) (stordir + 1);
+        file = (taa_asset_file*) taa_ALIGN_PTR(offset, 8);
+        offset = (uintptr_t) (file + n);
+        names = (char*) offset;
+        offset = (uintptr_t) (names + scan->namessize);
+        data = (char*) taa_ALIGN_PTR(offset, 8);
+        offset = (uintptr_t) (data + scan->namessize);
+        offset += n * (offsetof(taa_assetdir_file,path) + strlen(path) + 8);
+        // allocate the buffer and adjust pointers
+        offset = (uintptr_t) malloc(offset);
+        stordir = (taa_assetdir*) (((uintptr_t) stordir) + offset);
+        file = (taa_asset_file*) (((uintptr_t) file) + offset);
+        names = (char*) (((uintptr_t) names) + offset);
+        data = (char*) (((uintptr_t) data) + offset);
+        group = &stordir->group;
+        fileend = file + n;
+        memcpy(names, scan->names, scan->namessize);
+        // initialize directory struct and add to manager
+        stordir->mgr = mgr;
+        stordir->strings = NULL;
+#ifdef taa_ASSETDIR_FDCACHE
+        // files are opened relative to the directory, which avoids walking
+        // the full path on every open
+        stordir->dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+#ifdef taa_ASSETDIR_INOTIFY
+        stordir->path = taa_assetdir_strdup(stordir, path);
+        stordir->wd = -1;
+        stordir->capacity = n;
+        stordir->tables = NULL;
+        stordir->files = NULL;
+#endif
+        stordir->next = mgr->dirs;
+        mgr->dirs = stordir;
+        // initialize storage struct
+        group->name = taa_assetdir_strdup(stordir, name);
+        group->key = taa_asset_gen_groupkey(name);
+        group->numfiles = n;
+        group->files = file;
+        group->loadfunc = taa_assetdir_load;
+        // add files
+        entry = scan->entries;
+        while(file != fileend)
+        {
+            const char* fname = names + entry->nameoffset;
+            taa_assetdir_file* filedata = (taa_assetdir_file*) data;
+            char fpath[taa_PATH_SIZE];
+            uint32_t len;
+            // get the full path to the file
+            taa_path_set(fpath, sizeof(fpath), path);
+            taa_path_append(fpath, sizeof(fpath), fname);
+            len = strlen(fpath) + 1;
+            filedata->sortkey = entry->sortkey;
+            filedata->name = fname;
+#ifdef taa_ASSETDIR_FDCACHE
+            filedata->fd = NULL;
+#endif
+            filedata->next = NULL;
+            memcpy(filedata->path, fpath, len);
+            file->name = fname;
+            file->typekey = entry->typekey;
+            file->filekey = entry->filekey;
+            file->size = entry->size;
+            file->handle = (uintptr_t) filedata->path;
+            data = (char*) taa_ALIGN_PTR(filedata->path + len, 8);
+            ++entry;
+            ++file;
+        }
+        taa_assetdir_check_keys(group);
+    }
+    return group;
+}
+
+//****************************************************************************
+taa_asset_group* taa_asset_scan_dir(
+    taa_asset_dir_storage* mgr,
+    const char* name,
+    const char* path)
+{
+    taa_asset_group* group;
+    taa_assetdir_scan scan;
+    // read the directory once, collecting the names and sizes of its files
+    memset(&scan, 0, sizeof(scan));
+    taa_assetdir_scan_entries(path, mgr->flags, &scan);
+    group = taa_assetdir_create_group(mgr, name, path, &scan);
+    free(scan.entries);
+    free(scan.names);
+    return group;
+}
+
+//****************************************************************************
+taa_asset_group* taa_asset_scan_dir_manifest(
+    taa_asset_dir_storage* mgr,
+    const char* name,
+    const char* path,
+    const char* manifestpath)
+{
+    taa_asset_group* group;
+    taa_assetdir_manifest fingerprint;
+    taa_assetdir_scan scan;
+    memset(&fingerprint, 0, sizeof(fingerprint));
+    memset(&scan, 0, sizeof(scan));
+    fingerprint.flags = mgr->flags & taa_ASSETDIR_FIEMAP;
+    // the fingerprint is taken before scanning so that changes made while
+    // the scan is in progress invalidate the manifest that is written
+    if(!taa_assetdir_fingerprint(path, &fingerprint))
+    {
+        group = taa_asset_scan_dir(mgr, name, path);
+    }
+    else if(taa_assetdir_read_manifest(manifestpath, &fingerprint, &scan))
+    {
+        // the names are part of the entries buffer
+        group = taa_assetdir_create_group(mgr, name, path, &scan);
+        free(scan.entries);
+    }
+    else
+    {
+        taa_assetdir_scan_entries(path, mgr->flags, &scan);
+        if(scan.numentries > 0)
+        {
+            taa_assetdir_write_manifest(manifestpath, &fingerprint, &scan);
+        }
+        group = taa_assetdir_create_group(mgr, name, path, &scan);
+        free(scan.entries);
+        free(scan.names);
+    }
+    return group;
+}
+
+#ifdef taa_ASSETDIR_INOTIFY
+
+//****************************************************************************
+// returns the index of a file in the file table of a group, or the number
+// of files if it is not in the group
+static uint32_t taa_assetdir_find_file(
+    const taa_asset_group* group,
+    const char* fname)
+{
+    uint32_t typekey = taa_asset_gen_typekey(fname);
+    uint32_t filekey = taa_asset_gen_filekey(fname);
+    const taa_asset_file* file = group->files;
+    uint32_t i = 0;
+    while(i < group->numfiles)
+    {
+        if(file->filekey == filekey &&
+           file->typekey == typekey &&
+           !strcmp(file->name, fname))
+        {
+            break;
+        }
+        ++file;
+        ++i;
+    }
+    return i;
+}
+
+//****************************************************************************
+// creates the storage data for the current contents of a file in a watched
+// directory. returns NULL if the file does not exist or is not a regular
+// file. the name of the data must be set by the caller.
+static taa_assetdir_file* taa_assetdir_stat_file(
+    taa_assetdir* dir,
+    const char* fname,
+    uint32_t* size_out)
+{
+    taa_assetdir_file* data = NULL;
+    char fpath[taa_PATH_SIZE];
+    struct stat st;
+    taa_path_set(fpath, sizeof(fpath), dir->path);
+    taa_path_append(fpath, sizeof(fpath), fname);
+    if(stat(fpath, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        uint32_t len = strlen(fpath) + 1;
+        data = (taa_assetdir_file*) malloc(
+            offsetof(taa_assetdir_file, path) + len);
+        data->sortkey = (uint64_t) st.st_ino;
+        if((dir->mgr->flags & taa_ASSETDIR_FIEMAP) != 0)
+        {
+            data->sortkey = taa_assetdir_physical(
+                AT_FDCWD,
+                fpath,
+                data->sortkey);
+        }
+        data->name = NULL;
+#ifdef taa_ASSETDIR_FDCACHE
+        data->fd = NULL;
+#endif
+        memcpy(data->path, fpath, len);
+        data->next = dir->files;
+        dir->files = data;
+        *size_out = (uint32_t) st.st_size;
+    }
+    return data;
+}
+
+//****************************************************************************
+// appends a file to the table of a watched group. if the table is full, the
+// entries are moved to a table twice the size.
+static void taa_assetdir_add_file(
+    taa_assetdir* dir,
+    taa_assetdir_file* data,
+    uint32_t size,
+    taa_asset_dir_change_func func,
+    void* userdata)
+{
+    taa_asset_group* group = &dir->group;
+    taa_asset_file* file;
+    int typecollision = 0;
+    uint32_t i;
+    if(group->numfiles == dir->capacity)
+    {
+        uint32_t cap = dir->capacity * 2;
+        taa_assetdir_table* table;
+        table = (taa_assetdir_table*) malloc(
+            offsetof(taa_assetdir_table, files) + cap * sizeof(*file));
+        memcpy(table->files, group->files, group->numfiles*sizeof(*file));
+        table->next = dir->tables;
+        dir->tables = table;
+        dir->capacity = cap;
+        group->files = table->files;
+        for(i = 0; i < group->numfiles; ++i)
+        {
+            func(group, group->files + i, taa_ASSETDIR_FILE_MOVED, userdata);
+        }
+    }
+    file = group->files + group->numfiles;
+    file->name = data->name;
+    file->typekey = taa_asset_gen_typekey(data->name);
+    file->filekey = taa_asset_gen_filekey(data->name);
+    file->size = size;
+    file->handle = (uintptr_t) data->path;
+    // check the new file for collisions with the files already in the
+    // group, as they were checked with each other when it was scanned
+    for(i = 0; i < group->numfiles; ++i)
+    {
+        const taa_asset_file* other = group->files + i;
+        if(other->filekey == file->filekey &&
+           !taa_asset_same_file_stem(other->name, file->name))
+        {
+            taa_LOG_WARN(
+                "asset key collision in %s: %s and %s",
+                group->name,
+                other->name,
+                file->name);
+        }
+        else if(!typecollision &&
+                other->typekey == file->typekey &&
+                !taa_asset_same_file_ext(other->name, file->name))
+        {
+            taa_LOG_WARN(
+                "asset type key collision in %s: %s and %s",
+                group->name,
+                other->name,
+                file->name);
+            typecollision = 1;
+        }
+    }
+    ++group->numfiles;
+    func(group, file, taa_ASSETDIR_FILE_ADDED, userdata);
+}
+
+//****************************************************************************
+// removes a file from the table of a watched group by moving the last entry
+// of the table into its place
+static void taa_assetdir_remove_file(
+    taa_assetdir* dir,
+    uint32_t index,
+    taa_asset_dir_change_func func,
+    void* userdata)
+{
+    taa_asset_group* group = &dir->group;
+    taa_asset_file removed = group->files[index];
+    uint32_t last = group->numfiles - 1;
+#ifdef taa_ASSETDIR_FDCACHE
+    taa_assetdir_invalidate_fd(
+        dir->mgr,
+        taa_assetdir_file_data(removed.handle));
+#endif
+    group->files[index] = group->files[last];
+    group->numfiles = last;
+    func(group, &removed, taa_ASSETDIR_FILE_REMOVED, userdata);
+    if(index != last)
+    {
+        func(group,group->files+index,taa_ASSETDIR_FILE_MOVED,userdata);
+    }
+}
+
+//****************************************************************************
+// applies an event for a single file in a watched directory. the current
+// state of the file is checked rather than trusting the event, since the
+// file may have changed again since the event was queued. returns true if
+// the group changed.
+static int taa_assetdir_apply_event(
+    taa_assetdir* dir,
+    const struct inotify_event* ev,
+    taa_asset_dir_change_func func,
+    void* userdata)
+{
+    taa_asset_group* group = &dir->group;
+    uint32_t index = taa_assetdir_find_file(group, ev->name);
+    taa_assetdir_file* data = NULL;
+    uint32_t size = 0;
+    int changed = 1;
+    if((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0)
+    {
+        data = taa_assetdir_stat_file(dir, ev->name, &size);
+    }
+    if(data != NULL && index < group->numfiles)
+    {
+        // the data of the file is replaced rather than modified, so reads
+        // that are in flight are unaffected
+        taa_asset_file* file = group->files + index;
+#ifdef taa_ASSETDIR_FDCACHE
+        taa_assetdir_invalidate_fd(
+            dir->mgr,
+            taa_assetdir_file_data(file->handle));
+#endif
+        data->name = file->name;
+        file->size = size;
+        file->handle = (uintptr_t) data->path;
+        func(group, file, taa_ASSETDIR_FILE_MODIFIED, userdata);
+    }
+    else if(data != NULL)
+    {
+        data->name = taa_assetdir_strdup(dir, ev->name);
+        taa_assetdir_add_file(dir, data, size, func, userdata);
+    }
+    else if(index < group->numfiles)
+    {
+        taa_assetdir_remove_file(dir, index, func, userdata);
+    }
+    else
+    {
+        changed = 0;
+    }
+    return changed;
+}
+
+#endif // taa_ASSETDIR_INOTIFY
+
+//****************************************************************************
+int taa_asset_watch_dir(
+    taa_asset_dir_storage* mgr,
+    taa_asset_group* group)
+{
+    int result = 0;
+#ifdef taa_ASSETDIR_INOTIFY
+    taa_assetdir* dir = (taa_assetdir*) group;
+    if(mgr->inotifyfd < 0)
+    {
+        mgr->inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    if(mgr->inotifyfd >= 0 && dir->wd < 0)
+    {
+        // files are picked up once they have been written and closed, so
+        // partially written files are not loaded
+        dir->wd = inotify_add_watch(
+            mgr->inotifyfd,
+            dir->path,
+            IN_CLOSE_WRITE|IN_MOVED_TO|IN_DELETE|IN_MOVED_FROM|IN_ONLYDIR);
+    }
+    result = (dir->wd >= 0);
+#else
+    // directories cannot be watched without inotify
+    (void) mgr;
+    (void) group;
+#endif
+    return result;
+}
+
+//****************************************************************************
+uint32_t taa_asset_update_dir_storage(
+    taa_asset_dir_storage* mgr,
+    taa_asset_dir_change_func func,
+    void* userdata)
+{
+    uint32_t numchanges = 0;
+#ifdef taa_ASSETDIR_INOTIFY
+    if(mgr->inotifyfd >= 0)
+    {
+        // 64 bit elements keep the events suitably aligned
+        uint64_t buf[1024];
+        ssize_t n = read(mgr->inotifyfd, buf, sizeof(buf));
+        while(n > 0)
+        {
+            unsigned char* itr = (unsigned char*) buf;
+            unsigned char* end = itr + n;
+            while(itr != end)
+            {
+                struct inotify_event* ev = (struct inotify_event*) itr;
+                taa_assetdir* dir = mgr->dirs;
+                if((ev->mask & IN_Q_OVERFLOW) != 0)
+                {
+                    taa_LOG_WARN("directory events lost, rescan required");
+                    dir = NULL;
+                }
+                while(dir != NULL)
+                {
+                    // more than one group may watch the same directory
+                    if(dir->wd == ev->wd && (ev->mask & IN_IGNORED) != 0)
+                    {
+                        // the directory was removed
+                        dir->wd = -1;
+                    }
+                    else if(dir->wd == ev->wd && ev->len > 0)
+                    {
+                        numchanges += taa_assetdir_apply_event(
+                            dir,
+                            ev,
+                            func,
+                            userdata);
+                    }
+                    dir = dir->next;
+                }
+                itr += sizeof(*ev) + ev->len;
+            }
+            n = read(mgr->inotifyfd, buf, sizeof(buf));
+        }
+    }
+#else
+    // nothing is watched, so there are never any changes to report
+    (void) mgr;
+    (void) func;
+    (void) userdata;
+#endif
+    return numchanges;
 }
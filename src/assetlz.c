@@ -0,0 +1,248 @@
+/**
+ * @brief     lz block compression implementation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2011
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taa/assetlz.h>
+#include <string.h>
+
+enum
+{
+    // the number of bits used to index the match finder hash table
+    taa_ASSETLZ_HASH_BITS = 12,
+    taa_ASSETLZ_MIN_MATCH = 4,
+    taa_ASSETLZ_MAX_OFFSET = 0xffff,
+    // the format requires the final bytes of a block to be literals, and
+    // the last match to begin some distance before the end
+    taa_ASSETLZ_LAST_LITERALS = 5,
+    taa_ASSETLZ_MF_LIMIT = 12
+};
+
+//****************************************************************************
+static uint32_t taa_assetlz_read32(
+    const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+//****************************************************************************
+static uint32_t taa_assetlz_hash(
+    uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - taa_ASSETLZ_HASH_BITS);
+}
+
+//****************************************************************************
+// writes the remainder of a length that did not fit in the token
+static unsigned char* taa_assetlz_write_length(
+    unsigned char* op,
+    uint32_t len)
+{
+    while(len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char) len;
+    return op;
+}
+
+//****************************************************************************
+// writes a sequence of literals followed by a match. if matchlen is zero,
+// only the literals are written, which is how a block is terminated.
+// returns NULL if the sequence does not fit in the output.
+static unsigned char* taa_assetlz_write_sequence(
+    unsigned char* op,
+    unsigned char* opend,
+    const unsigned char* literals,
+    uint32_t litlen,
+    uint32_t offset,
+    uint32_t matchlen)
+{
+    uint32_t worstcase = 1 + litlen + litlen/255 + 1 + 2 + matchlen/255 + 1;
+    unsigned char* token = op;
+    if(worstcase > (uint32_t) (opend - op))
+    {
+        return NULL;
+    }
+    ++op;
+    *token = (unsigned char) (((litlen < 15) ? litlen : 15) << 4);
+    if(litlen >= 15)
+    {
+        op = taa_assetlz_write_length(op, litlen - 15);
+    }
+    memcpy(op, literals, litlen);
+    op += litlen;
+    if(matchlen > 0)
+    {
+        uint32_t ml = matchlen - taa_ASSETLZ_MIN_MATCH;
+        *op++ = (unsigned char) (offset & 0xff);
+        *op++ = (unsigned char) (offset >> 8);
+        *token |= (unsigned char) ((ml < 15) ? ml : 15);
+        if(ml >= 15)
+        {
+            op = taa_assetlz_write_length(op, ml - 15);
+        }
+    }
+    return op;
+}
+
+//****************************************************************************
+uint32_t taa_asset_lz_bound(
+    uint32_t size)
+{
+    return size + size/255 + 16;
+}
+
+//****************************************************************************
+uint32_t taa_asset_lz_compress(
+    const void* src,
+    uint32_t srcsize,
+    void* dst,
+    uint32_t dstcapacity)
+{
+    uint32_t table[1 << taa_ASSETLZ_HASH_BITS];
+    const unsigned char* base = (const unsigned char*) src;
+    unsigned char* op = (unsigned char*) dst;
+    unsigned char* opend = op + dstcapacity;
+    uint32_t anchor = 0;
+    uint32_t ip = 0;
+    if(srcsize > taa_ASSETLZ_MF_LIMIT)
+    {
+        uint32_t mflimit = srcsize - taa_ASSETLZ_MF_LIMIT;
+        uint32_t matchlimit = srcsize - taa_ASSETLZ_LAST_LITERALS;
+        memset(table, 0, sizeof(table));
+        while(op != NULL && ip < mflimit)
+        {
+            uint32_t seq = taa_assetlz_read32(base + ip);
+            uint32_t h = taa_assetlz_hash(seq);
+            uint32_t ref = table[h];
+            table[h] = ip;
+            if(ref < ip &&
+               ip - ref <= taa_ASSETLZ_MAX_OFFSET &&
+               taa_assetlz_read32(base + ref) == seq)
+            {
+                uint32_t len = taa_ASSETLZ_MIN_MATCH;
+                while(ip + len < matchlimit && base[ref+len] == base[ip+len])
+                {
+                    ++len;
+                }
+                op = taa_assetlz_write_sequence(
+                    op,
+                    opend,
+                    base + anchor,
+                    ip - anchor,
+                    ip - ref,
+                    len);
+                ip += len;
+                anchor = ip;
+            }
+            else
+            {
+                // skip ahead faster the longer no match has been found so
+                // that incompressible data does not take long to process
+                ip += 1 + ((ip - anchor) >> 6);
+            }
+        }
+    }
+    if(op != NULL)
+    {
+        op = taa_assetlz_write_sequence(
+            op,
+            opend,
+            base + anchor,
+            srcsize - anchor,
+            0,
+            0);
+    }
+    return (op != NULL) ? (uint32_t) (op - (unsigned char*) dst) : 0;
+}
+
+//****************************************************************************
+int taa_asset_lz_decompress(
+    const void* src,
+    uint32_t srcsize,
+    void* dst,
+    uint32_t dstsize)
+{
+    const unsigned char* ip = (const unsigned char*) src;
+    const unsigned char* ipend = ip + srcsize;
+    unsigned char* op = (unsigned char*) dst;
+    unsigned char* opend = op + dstsize;
+    int ok = 1;
+    while(ok && ip != ipend)
+    {
+        uint32_t token = *ip++;
+        uint32_t litlen = token >> 4;
+        if(litlen == 15)
+        {
+            uint32_t b = 255;
+            while(b == 255 && ip != ipend)
+            {
+                b = *ip++;
+                litlen += b;
+            }
+            ok = (b != 255);
+        }
+        if(ok &&
+           litlen <= (uint32_t) (ipend - ip) &&
+           litlen <= (uint32_t) (opend - op))
+        {
+            memcpy(op, ip, litlen);
+            ip += litlen;
+            op += litlen;
+        }
+        else
+        {
+            ok = 0;
+        }
+        if(ok && ip != ipend)
+        {
+            // every sequence but the last is followed by a match
+            uint32_t offset = 0;
+            uint32_t matchlen = token & 15;
+            if(ipend - ip >= 2)
+            {
+                offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+            }
+            if(matchlen == 15)
+            {
+                uint32_t b = 255;
+                while(b == 255 && ip != ipend)
+                {
+                    b = *ip++;
+                    matchlen += b;
+                }
+                ok = (b != 255);
+            }
+            matchlen += taa_ASSETLZ_MIN_MATCH;
+            if(ok &&
+               offset != 0 &&
+               offset <= (uint32_t) (op - (unsigned char*) dst) &&
+               matchlen <= (uint32_t) (opend - op))
+            {
+                const unsigned char* match = op - offset;
+                // an overlapping match repeats the previous offset bytes.
+                // each copy reads only bytes that have already been written,
+                // which doubles the length of the pattern every time.
+                while(matchlen > 0)
+                {
+                    uint32_t n = (uint32_t) (op - match);
+                    n = (matchlen < n) ? matchlen : n;
+                    memcpy(op, match, n);
+                    op += n;
+                    matchlen -= n;
+                }
+            }
+            else
+            {
+                ok = 0;
+            }
+        }
+    }
+    return ok && op == opend;
+}
@@ -7,45 +7,361 @@
 #include <taa/assetmap.h>
 #include <taa/log.h>
 #include <taa/path.h>
+#include <taa/spinlock.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
+// the metadata of a group of index slots is compared with a single sse2
+// instruction where it is available
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define taa_ASSETMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+enum
+{
+    // the number of index slots whose metadata is examined at once
+    taa_ASSETMAP_GROUP_SIZE = 16,
+    // the metadata byte of a slot that does not hold a key. the metadata
+    // of other slots is 7 bits of the hash of the key.
+    taa_ASSETMAP_EMPTY = 0x80,
+    // the number of keys taa_asset_find_many searches for at the same time
+    taa_ASSETMAP_BATCH_SIZE = 32
+};
+
+typedef struct taa_asset_map_entry_s taa_asset_map_entry;
+typedef struct taa_asset_map_chunk_s taa_asset_map_chunk;
+typedef struct taa_asset_map_index_s taa_asset_map_index;
+typedef struct taa_asset_map_slot_s taa_asset_map_slot;
+
+// the storage of a value. entries are never moved, so a reader may keep
+// using the value of a key that is removed while it is being read.
+struct taa_asset_map_entry_s
+{
+    taa_asset_map_value value;
+    // links the entry into the free list or a list of retired entries
+    taa_asset_map_entry* next;
+};
+
+struct taa_asset_map_chunk_s
+{
+    taa_asset_map_chunk* next;
+    taa_asset_map_entry entries[1];
+};
+
+// a slot of the hash index. the key is stored next to its value so that a
+// lookup only has to touch the value once the key has been found.
+struct taa_asset_map_slot_s
+{
+    uint64_t key;
+    taa_asset_map_value* value;
+};
+
+// hash index of the keys. each slot holds a key and its value along with a
+// metadata byte, and the metadata bytes are stored apart from the slots so
+// that a whole group of slots can be checked for a key with a few
+// instructions. collisions are resolved by probing consecutive groups. an
+// index is never modified once it has been published; writers publish a
+// new index instead.
+struct taa_asset_map_index_s
+{
+    // links the index into a list of retired indexes
+    taa_asset_map_index* next;
+    unsigned char* meta;
+    taa_asset_map_slot* slots;
+    uint32_t numgroups;
+};
+
 struct taa_asset_map_s
 {
-    taa_asset_key* keys;
-    taa_asset_map_value* values;
+    // the index that lookups use. readers load it without taking a lock.
+    taa_asset_map_index* index;
+    // the number of readers that entered during an even or odd epoch
+    int32_t readers[2];
+    uint32_t epoch;
+    // indexes and entries that were replaced or removed during the current
+    // and the previous epoch, which readers may still be using
+    taa_asset_map_index* retiredindexes[2];
+    taa_asset_map_entry* retiredentries[2];
+    // the remaining members are only accessed by writers, which are
+    // serialized by the write lock
+    int writelock;
+    // the keys and entries are kept sorted by key. the keys are stored as
+    // 64 bit values with the group key in the upper half, so that they can
+    // be ordered with a single comparison.
+    uint64_t* keys;
+    taa_asset_map_entry** entries;
     uint32_t size;
     uint32_t capacity;
+    taa_asset_map_entry* freeentries;
+    taa_asset_map_chunk* chunks;
 };
 
 //****************************************************************************
-static unsigned int taa_asset_map_search(
-    const taa_asset_key* keys,
-    unsigned int numkeys,
+// returns the key in the form stored in the sorted array
+static uint64_t taa_asset_map_order(
     uint32_t groupkey,
     uint32_t filekey)
 {
-    unsigned int lo = 0;
-    unsigned int hi = numkeys;
-    while(lo < hi)
+    return (((uint64_t) groupkey) << 32) | filekey;
+}
+
+//****************************************************************************
+// returns the position of the first key that is not less than the specified
+// key. the loop has no branches other than its exit condition, since the
+// compiler turns the selection of the half into a conditional move, and the
+// keys that may be compared two steps ahead are prefetched.
+static uint32_t taa_asset_map_search(
+    const uint64_t* keys,
+    uint32_t numkeys,
+    uint64_t key)
+{
+    const uint64_t* base = keys;
+    uint32_t n = numkeys;
+    uint32_t result = 0;
+    if(n > 0)
+    {
+        while(n > 1)
+        {
+            uint32_t half = n >> 1;
+#if defined(__GNUC__)
+            __builtin_prefetch(base + (half >> 1));
+            __builtin_prefetch(base + half + (half >> 1));
+#endif
+            base = (base[half] < key) ? base + half : base;
+            n -= half;
+        }
+        result = (uint32_t) (base - keys) + (*base < key);
+    }
+    return result;
+}
+
+//****************************************************************************
+// mixes every bit of a key into every bit of the hash, since many keys share
+// the same group key
+static uint64_t taa_asset_map_hash(
+    uint64_t key)
+{
+    uint64_t h = key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//****************************************************************************
+// returns a bit mask of the slots in a group whose metadata matches a value
+static uint32_t taa_asset_map_match(
+    const unsigned char* meta,
+    unsigned char value)
+{
+#ifdef taa_ASSETMAP_SSE2
+    __m128i m = _mm_loadu_si128((const __m128i*) meta);
+    __m128i v = _mm_set1_epi8((char) value);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(m, v));
+#else
+    uint32_t mask = 0;
+    uint32_t i;
+    for(i = 0; i < taa_ASSETMAP_GROUP_SIZE; ++i)
+    {
+        mask |= ((uint32_t) (meta[i] == value)) << i;
+    }
+    return mask;
+#endif
+}
+
+//****************************************************************************
+// returns the index of the lowest bit set in a nonzero mask
+static uint32_t taa_asset_map_lowest_bit(
+    uint32_t mask)
+{
+#if defined(__GNUC__)
+    return (uint32_t) __builtin_ctz(mask);
+#else
+    uint32_t i = 0;
+    while((mask & 1) == 0)
     {
-        unsigned int i = lo + ((hi-lo) >> 1);
-        const taa_asset_key* k = keys + i;
-        if(k->parts.group < groupkey)
+        mask >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+//****************************************************************************
+// frees the memory that was retired during the previous epoch and advances
+// the epoch, once every reader that entered during the previous epoch has
+// left. readers that enter after a replaced index is retired can only see
+// its replacement, so anything retired before the epoch advanced twice is
+// no longer reachable.
+static void taa_asset_map_collect(
+    taa_asset_map* map)
+{
+    uint32_t prev = (map->epoch + 1) & 1;
+    // the exchange reads the count with a full barrier, so the frees can
+    // not be ordered before it
+    if(taa_ATOMIC_CMPXCHG_32(map->readers + prev, 0, 0) == 0)
+    {
+        taa_asset_map_index* index = map->retiredindexes[prev];
+        taa_asset_map_entry* entry = map->retiredentries[prev];
+        while(index != NULL)
         {
-            lo = i + 1;
+            taa_asset_map_index* next = index->next;
+            free(index);
+            index = next;
         }
-        else if(k->parts.group == groupkey && k->parts.file < filekey)
+        while(entry != NULL)
         {
-            lo = i + 1;
+            taa_asset_map_entry* next = entry->next;
+            entry->next = map->freeentries;
+            map->freeentries = entry;
+            entry = next;
         }
-        else
+        map->retiredindexes[prev] = NULL;
+        map->retiredentries[prev] = NULL;
+        taa_MEMORY_BARRIER();
+        ++map->epoch;
+    }
+}
+
+//****************************************************************************
+// builds a hash index of the sorted arrays and publishes it to readers. the
+// index is sized to keep it at most 7/8 full.
+static void taa_asset_map_publish(
+    taa_asset_map* map)
+{
+    taa_asset_map_index* index;
+    taa_asset_map_index* old;
+    unsigned char* meta;
+    taa_asset_map_slot* slots;
+    uint32_t numgroups = 1;
+    uint32_t numslots;
+    uint32_t groupmask;
+    uint32_t i;
+    uintptr_t offset;
+    while(map->size > numgroups * (taa_ASSETMAP_GROUP_SIZE * 7 / 8))
+    {
+        numgroups *= 2;
+    }
+    numslots = numgroups * taa_ASSETMAP_GROUP_SIZE;
+    // determine buffer size and pointer offsets
+    offset = 0;
+    index = (taa_asset_map_index*) offset;
+    offset = (uintptr_t) (index + 1);
+    meta = (unsigned char*) offset;
+    offset = (uintptr_t) (meta + numslots);
+    slots = (taa_asset_map_slot*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (slots + numslots);
+    // allocate the buffer and adjust pointers
+    offset = (uintptr_t) malloc(offset);
+    index = (taa_asset_map_index*) (((uintptr_t) index) + offset);
+    meta = (unsigned char*) (((uintptr_t) meta) + offset);
+    slots = (taa_asset_map_slot*) (((uintptr_t) slots) + offset);
+    // build the index
+    index->next = NULL;
+    index->meta = meta;
+    index->slots = slots;
+    index->numgroups = numgroups;
+    memset(meta, taa_ASSETMAP_EMPTY, numslots);
+    groupmask = numgroups - 1;
+    for(i = 0; i < map->size; ++i)
+    {
+        uint64_t h = taa_asset_map_hash(map->keys[i]);
+        uint32_t group = ((uint32_t) h) & groupmask;
+        unsigned char* groupmeta = meta + group*taa_ASSETMAP_GROUP_SIZE;
+        taa_asset_map_slot* slot;
+        uint32_t empty;
+        // the index is never full, so an empty slot is always found
+        empty = taa_asset_map_match(groupmeta, taa_ASSETMAP_EMPTY);
+        while(empty == 0)
         {
-            hi = i;
+            group = (group + 1) & groupmask;
+            groupmeta = meta + group*taa_ASSETMAP_GROUP_SIZE;
+            empty = taa_asset_map_match(groupmeta, taa_ASSETMAP_EMPTY);
         }
+        empty = taa_asset_map_lowest_bit(empty);
+        groupmeta[empty] = (unsigned char) (h >> 57);
+        slot = slots + group*taa_ASSETMAP_GROUP_SIZE + empty;
+        slot->key = map->keys[i];
+        slot->value = &map->entries[i]->value;
+    }
+    // the index and the values it refers to must be visible before the
+    // index itself
+    old = map->index;
+    taa_MEMORY_BARRIER();
+    map->index = index;
+    if(old != NULL)
+    {
+        old->next = map->retiredindexes[map->epoch & 1];
+        map->retiredindexes[map->epoch & 1] = old;
+    }
+    taa_asset_map_collect(map);
+}
+
+//****************************************************************************
+// allocates a chunk of entries and adds them to the free list
+static void taa_asset_map_add_entries(
+    taa_asset_map* map,
+    uint32_t count)
+{
+    if(count > 0)
+    {
+        taa_asset_map_chunk* chunk;
+        uint32_t i;
+        chunk = (taa_asset_map_chunk*) malloc(
+            sizeof(*chunk) + (count - 1)*sizeof(chunk->entries[0]));
+        chunk->next = map->chunks;
+        map->chunks = chunk;
+        for(i = 0; i < count; ++i)
+        {
+            chunk->entries[i].next = map->freeentries;
+            map->freeentries = chunk->entries + i;
+        }
+    }
+}
+
+//****************************************************************************
+// ensures there are entries and room in the sorted arrays for the specified
+// number of values
+static void taa_asset_map_reserve(
+    taa_asset_map* map,
+    uint32_t total)
+{
+    if(total > map->capacity)
+    {
+        uint32_t sz;
+        // grow geometrically so that repeated inserts take linear time
+        uint32_t ncap = map->capacity * 2;
+        ncap = (ncap > total) ? ncap : total;
+        ncap = (ncap + 15) & ~15; // round to nearest 16
+        sz = ncap * sizeof(*map->keys);
+        map->keys = (uint64_t*) realloc(map->keys, sz);
+        sz = ncap * sizeof(*map->entries);
+        map->entries = (taa_asset_map_entry**) realloc(map->entries, sz);
+        taa_asset_map_add_entries(map, ncap - map->capacity);
+        map->capacity = ncap;
+        taa_LOG_WARN("asset map over capacity. resized to: %u", ncap);
     }
-    return lo;
+}
+
+//****************************************************************************
+// removes an entry from the free list. the list may run out while removed
+// entries are waiting for readers to leave, in which case more are added.
+static taa_asset_map_entry* taa_asset_map_alloc_entry(
+    taa_asset_map* map)
+{
+    taa_asset_map_entry* entry;
+    if(map->freeentries == NULL)
+    {
+        taa_asset_map_add_entries(map, 16);
+    }
+    entry = map->freeentries;
+    map->freeentries = entry->next;
+    entry->value.asset = NULL;
+    return entry;
 }
 
 //****************************************************************************
@@ -55,9 +371,12 @@ void taa_asset_create_map(
 {
     taa_asset_map* map;
     map = (taa_asset_map*) calloc(1, sizeof(*map));
-    map->keys = (taa_asset_key*) malloc(capacity * sizeof(*map->keys));
-    map->values = (taa_asset_map_value*) malloc(capacity*sizeof(*map->values));
+    map->keys = (uint64_t*) malloc(capacity * sizeof(*map->keys));
+    map->entries = (taa_asset_map_entry**) malloc(
+        capacity * sizeof(*map->entries));
     map->capacity = capacity;
+    taa_asset_map_add_entries(map, capacity);
+    taa_asset_map_publish(map);
     *map_out = map;
 }
 
@@ -65,30 +384,241 @@ void taa_asset_create_map(
 void taa_asset_destroy_map(
     taa_asset_map* map)
 {
+    taa_asset_map_chunk* chunk = map->chunks;
+    uint32_t i;
+    for(i = 0; i < 2; ++i)
+    {
+        taa_asset_map_index* index = map->retiredindexes[i];
+        while(index != NULL)
+        {
+            taa_asset_map_index* next = index->next;
+            free(index);
+            index = next;
+        }
+    }
+    while(chunk != NULL)
+    {
+        taa_asset_map_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(map->index);
     free(map->keys);
-    free(map->values);
+    free(map->entries);
     free(map);
 };
 
+//****************************************************************************
+uint32_t taa_asset_begin_map_read(
+    taa_asset_map* map)
+{
+    uint32_t epoch = map->epoch;
+    int32_t* readers = map->readers + (epoch & 1);
+    taa_ATOMIC_INC_32(readers);
+    // the reader is only counted if the epoch did not advance before it was
+    // registered. otherwise it registers again with the new epoch. this
+    // can only repeat while writers keep advancing the epoch.
+    while(map->epoch != epoch)
+    {
+        taa_ATOMIC_DEC_32(readers);
+        epoch = map->epoch;
+        readers = map->readers + (epoch & 1);
+        taa_ATOMIC_INC_32(readers);
+    }
+    return epoch & 1;
+}
+
+//****************************************************************************
+void taa_asset_end_map_read(
+    taa_asset_map* map,
+    uint32_t token)
+{
+    taa_ATOMIC_DEC_32(map->readers + token);
+}
+
+//****************************************************************************
+// returns the value of a key in an index given the hash of the key
+static taa_asset_map_value* taa_asset_map_probe(
+    const taa_asset_map_index* index,
+    uint64_t key,
+    uint64_t h)
+{
+    taa_asset_map_value* result = NULL;
+    unsigned char tag = (unsigned char) (h >> 57);
+    uint32_t groupmask = index->numgroups - 1;
+    uint32_t group = ((uint32_t) h) & groupmask;
+    int done = 0;
+    while(!done)
+    {
+        const unsigned char* meta;
+        const taa_asset_map_slot* slots;
+        uint32_t match;
+        meta = index->meta + group*taa_ASSETMAP_GROUP_SIZE;
+        slots = index->slots + group*taa_ASSETMAP_GROUP_SIZE;
+        match = taa_asset_map_match(meta, tag);
+        while(match != 0 && result == NULL)
+        {
+            const taa_asset_map_slot* slot;
+            slot = slots + taa_asset_map_lowest_bit(match);
+            if(slot->key == key)
+            {
+                result = slot->value;
+            }
+            match &= match - 1;
+        }
+        // a key is never placed past a group with an empty slot
+        done = result != NULL ||
+               taa_asset_map_match(meta, taa_ASSETMAP_EMPTY) != 0;
+        group = (group + 1) & groupmask;
+    }
+    return result;
+}
+
 //****************************************************************************
 taa_asset_map_value* taa_asset_find(
     const taa_asset_map* map,
     const taa_asset_key key)
 {
-    taa_asset_map_value* result = NULL;
-    uint32_t i = taa_asset_map_search(
-        map->keys,
-        map->size,
-        key.parts.group,
-        key.parts.file);
-    if(i < map->size)
+    uint64_t k = taa_asset_map_order(key.parts.group, key.parts.file);
+    return taa_asset_map_probe(map->index, k, taa_asset_map_hash(k));
+}
+
+//****************************************************************************
+void taa_asset_find_many(
+    const taa_asset_map* map,
+    const taa_asset_key* keys,
+    uint32_t numkeys,
+    taa_asset_map_value** values_out)
+{
+    const taa_asset_map_index* index = map->index;
+    uint32_t groupmask = index->numgroups - 1;
+    uint32_t base;
+    // the keys are looked up in batches. each step of the search is done
+    // for the whole batch before the next, and the memory the next step
+    // reads is prefetched, so the cache misses of a batch overlap instead
+    // of being taken one after another.
+    for(base = 0; base < numkeys; base += taa_ASSETMAP_BATCH_SIZE)
     {
-        if(map->keys[i].all == key.all)
+        uint64_t k[taa_ASSETMAP_BATCH_SIZE];
+        uint64_t h[taa_ASSETMAP_BATCH_SIZE];
+        uint32_t n = numkeys - base;
+        uint32_t i;
+        n = (n < taa_ASSETMAP_BATCH_SIZE) ? n : taa_ASSETMAP_BATCH_SIZE;
+        // hash the keys and fetch the metadata of their groups
+        for(i = 0; i < n; ++i)
         {
-            result = map->values + i;
+            taa_asset_key key = keys[base + i];
+            uint32_t group;
+            k[i] = taa_asset_map_order(key.parts.group, key.parts.file);
+            h[i] = taa_asset_map_hash(k[i]);
+            group = ((uint32_t) h[i]) & groupmask;
+#if defined(__GNUC__)
+            __builtin_prefetch(index->meta+group*taa_ASSETMAP_GROUP_SIZE);
+#endif
+        }
+        // match the metadata and fetch the first slot that matches
+        for(i = 0; i < n; ++i)
+        {
+            uint32_t group = ((uint32_t) h[i]) & groupmask;
+            uint32_t match = taa_asset_map_match(
+                index->meta + group*taa_ASSETMAP_GROUP_SIZE,
+                (unsigned char) (h[i] >> 57));
+            if(match != 0)
+            {
+                uint32_t slot = group*taa_ASSETMAP_GROUP_SIZE;
+                slot += taa_asset_map_lowest_bit(match);
+#if defined(__GNUC__)
+                __builtin_prefetch(index->slots + slot);
+#endif
+            }
+        }
+        // complete the searches, which now mostly read cached memory
+        for(i = 0; i < n; ++i)
+        {
+            values_out[base + i] = taa_asset_map_probe(index, k[i], h[i]);
         }
     }
-    return result;
+}
+
+//****************************************************************************
+taa_asset_map_value* taa_asset_insert(
+    taa_asset_map* map,
+    taa_asset_group* group,
+    taa_asset_file* file)
+{
+    taa_asset_map_value* val;
+    uint64_t k = taa_asset_map_order(group->key, file->filekey);
+    uint32_t i;
+    taa_SPINLOCK_LOCK(&map->writelock);
+    i = taa_asset_map_search(map->keys, map->size, k);
+    if(i < map->size && map->keys[i] == k)
+    {
+        val = &map->entries[i]->value;
+        val->group = group;
+        val->file = file;
+    }
+    else
+    {
+        // make room for the key at its sorted position
+        uint32_t n = map->size - i;
+        taa_asset_map_entry* entry;
+        taa_asset_map_reserve(map, map->size + 1);
+        memmove(map->keys + i + 1, map->keys + i, n*sizeof(*map->keys));
+        memmove(map->entries+i+1, map->entries+i, n*sizeof(*map->entries));
+        entry = taa_asset_map_alloc_entry(map);
+        val = &entry->value;
+        val->group = group;
+        val->file = file;
+        map->keys[i] = k;
+        map->entries[i] = entry;
+        ++map->size;
+        taa_asset_map_publish(map);
+    }
+    taa_SPINLOCK_UNLOCK(&map->writelock);
+    return val;
+}
+
+//****************************************************************************
+// sorts records by their upper 32 bits, which hold the file key, one byte
+// at a time from least to most significant. because each pass is stable,
+// records with the same file key stay in file table order. returns the
+// buffer that holds the sorted records.
+static uint64_t* taa_asset_map_radix_sort(
+    uint64_t* records,
+    uint64_t* tmp,
+    uint32_t n)
+{
+    uint32_t shift;
+    for(shift = 32; shift < 64; shift += 8)
+    {
+        uint32_t counts[256];
+        uint32_t sum = 0;
+        uint32_t i;
+        memset(counts, 0, sizeof(counts));
+        for(i = 0; i < n; ++i)
+        {
+            ++counts[(records[i] >> shift) & 0xff];
+        }
+        // a pass is skipped when every record has the same byte
+        if(counts[(records[0] >> shift) & 0xff] != n)
+        {
+            uint64_t* swap;
+            for(i = 0; i < 256; ++i)
+            {
+                uint32_t c = counts[i];
+                counts[i] = sum;
+                sum += c;
+            }
+            for(i = 0; i < n; ++i)
+            {
+                tmp[counts[(records[i] >> shift) & 0xff]++] = records[i];
+            }
+            swap = records;
+            records = tmp;
+            tmp = swap;
+        }
+    }
+    return records;
 }
 
 //****************************************************************************
@@ -96,90 +626,212 @@ void taa_asset_register_group(
     taa_asset_map* map,
     taa_asset_group* group,
     uint32_t typekey)
+{
+    taa_asset_register_group_types(map, group, &typekey, 1);
+}
+
+//****************************************************************************
+void taa_asset_register_group_types(
+    taa_asset_map* map,
+    taa_asset_group* group,
+    const uint32_t* typekeys,
+    uint32_t numtypekeys)
 {
     uint32_t groupkey = group->key;
+    uint32_t numfiles = group->numfiles;
+    uint64_t* buf;
+    uint64_t* records;
+    taa_asset_file* prev = NULL;
     uint32_t n;
-    uint32_t total;
-    taa_asset_key* keyitr;
-    taa_asset_key* keydst;
-    taa_asset_map_value* valitr;
-    taa_asset_map_value* valdst;
-    taa_asset_file* fileitr;
-    taa_asset_file* fileend;
-    // count the relevant number of files in the group
-    fileitr = group->files;
-    fileend = fileitr+group->numfiles;
+    uint32_t numnew;
+    uint32_t i;
+    uint32_t j;
+    uint32_t dst;
+    // collect the file key and file index of each matching file
+    buf = (uint64_t*) malloc(2 * numfiles * sizeof(*buf) + 1);
+    taa_SPINLOCK_LOCK(&map->writelock);
     n = 0;
-    while(fileitr != fileend)
+    for(i = 0; i < numfiles; ++i)
     {
-        if(fileitr->typekey == typekey)
+        uint32_t typekey = group->files[i].typekey;
+        uint32_t t = 0;
+        while(t < numtypekeys && typekeys[t] != typekey)
         {
-            ++n;
+            ++t;
+        }
+        if(t < numtypekeys)
+        {
+            buf[n++] = (((uint64_t) group->files[i].filekey) << 32) | i;
         }
-        ++fileitr;
     }
-    total = map->size + n;
-    // ensure buffers have enough capacity
-    if(total > map->capacity)
+    records = buf;
+    if(n > 0)
     {
-        uint32_t sz;
-        uint32_t ncap = (total + 15) & ~15; // round to nearest 16
-        sz = ncap * sizeof(*map->keys);
-        map->keys = (taa_asset_key*) realloc(map->keys, sz);
-        sz = ncap * sizeof(*map->values);
-        map->values=(taa_asset_map_value*) realloc(map->values, sz);
-        map->capacity = ncap;
-        taa_LOG_WARN("asset map over capacity. resized to: %u", ncap);
+        records = taa_asset_map_radix_sort(buf, buf + numfiles, n);
     }
-    // make room to insert the nodes at the correct position
-    keyitr = map->keys + map->size;
-    keydst = map->keys + total - 1;
-    valitr = map->values + map->size;
-    valdst = map->values + total - 1;
-    while(keyitr != map->keys && keyitr->parts.group > groupkey)
-    {
-        *keydst = *keyitr;
-        *valdst = *valitr;
-        --keyitr;
-        --keydst;
-        --valitr;
-        --valdst;
-    }
-    // loop through the files again and insert the data
-    fileitr = group->files;
-    fileend = fileitr+group->numfiles;
-    n = 0;
-    while(fileitr != fileend)
-    {
-        if(fileitr->typekey == typekey)
-        {
-            taa_asset_key* key;
-            taa_asset_map_value* val;
-            uint32_t i;
-            i = taa_asset_map_search(keyitr,n,groupkey,fileitr->filekey);
-            // TODO: check for hash conflicts?
-            // make room for the file
-            key = keyitr + i;
-            val = valitr + i;
-            keydst = keyitr + n;
-            valdst = valitr + n;
-            while(keydst > key)
+    // drop files whose keys are already in the map or were already taken by
+    // an earlier file in the group, so that only new keys remain
+    numnew = 0;
+    for(i = 0; i < n; ++i)
+    {
+        taa_asset_file* file = group->files + (uint32_t) records[i];
+        taa_asset_map_value* val;
+        taa_asset_key key;
+        key.parts.group = groupkey;
+        key.parts.file = file->filekey;
+        val = taa_asset_find(map, key);
+        if(i > 0 &&
+           key.parts.file == prev->filekey &&
+           taa_asset_same_file_stem(prev->name, file->name))
+        {
+            // files that only differ in extension are expected to share a
+            // key when more than one type is registered
+            taa_LOG_WARN(
+                "asset key conflict in %s: %s and %s",
+                group->name,
+                prev->name,
+                file->name);
+        }
+        else if(i > 0 && key.parts.file == prev->filekey)
+        {
+            taa_LOG_WARN(
+                "asset key collision in %s: %s and %s",
+                group->name,
+                prev->name,
+                file->name);
+        }
+        else if(val != NULL)
+        {
+            // the file replaces the one that was registered with the key
+            val->group = group;
+            val->file = file;
+        }
+        else
+        {
+            records[numnew++] = records[i];
+        }
+        if(i == 0 || key.parts.file != prev->filekey)
+        {
+            prev = file;
+        }
+    }
+    // merge the new keys into the sorted arrays from back to front, so
+    // that every existing value is moved at most once
+    taa_asset_map_reserve(map, map->size + numnew);
+    i = map->size;
+    j = numnew;
+    dst = map->size + numnew;
+    while(j > 0)
+    {
+        uint32_t filekey = (uint32_t) (records[j - 1] >> 32);
+        uint64_t k = taa_asset_map_order(groupkey, filekey);
+        --dst;
+        if(i > 0 && map->keys[i - 1] > k)
+        {
+            map->keys[dst] = map->keys[i - 1];
+            map->entries[dst] = map->entries[i - 1];
+            --i;
+        }
+        else
+        {
+            taa_asset_map_entry* entry = taa_asset_map_alloc_entry(map);
+            entry->value.group = group;
+            entry->value.file = group->files + (uint32_t) records[j - 1];
+            map->keys[dst] = k;
+            map->entries[dst] = entry;
+            --j;
+        }
+    }
+    // the existing values in front of the new keys are already in place
+    assert(dst == i);
+    map->size += numnew;
+    if(numnew > 0)
+    {
+        taa_asset_map_publish(map);
+    }
+    taa_SPINLOCK_UNLOCK(&map->writelock);
+    free(buf);
+}
+
+//****************************************************************************
+void taa_asset_unregister_group(
+    taa_asset_map* map,
+    taa_asset_group* group)
+{
+    uint64_t groupkey = group->key;
+    uint32_t first;
+    uint32_t last;
+    taa_SPINLOCK_LOCK(&map->writelock);
+    // the keys of a group are contiguous, since the group key is the most
+    // significant half of each key
+    first = taa_asset_map_search(map->keys, map->size, groupkey << 32);
+    last = map->size;
+    if(groupkey < 0xffffffffU)
+    {
+        last = taa_asset_map_search(
+            map->keys,
+            map->size,
+            (groupkey + 1) << 32);
+    }
+    if(first < last)
+    {
+        uint32_t n = map->size - last;
+        uint32_t dst = first;
+        uint32_t i;
+        // keys may have been moved to a newer group with the same name, so
+        // only the entries that still refer to this group are removed. the
+        // rest are compacted in the same pass. the entries are retired
+        // rather than freed, since readers may still be using their values.
+        for(i = first; i < last; ++i)
+        {
+            taa_asset_map_entry* entry = map->entries[i];
+            if(entry->value.group == group)
             {
-                *keydst = keydst[-1];
-                *valdst = valdst[-1];
-                --keydst;
-                --valdst;
+                entry->next = map->retiredentries[map->epoch & 1];
+                map->retiredentries[map->epoch & 1] = entry;
+            }
+            else
+            {
+                map->keys[dst] = map->keys[i];
+                map->entries[dst] = entry;
+                ++dst;
             }
-            // insert the value
-            key->parts.group = groupkey;
-            key->parts.file = fileitr->filekey;
-            val->group = group;
-            val->file = fileitr;
-            val->asset = NULL;
-            ++n;
         }
-        ++fileitr;
+        if(dst != last)
+        {
+            memmove(map->keys+dst, map->keys+last, n*sizeof(*map->keys));
+            memmove(
+                map->entries + dst,
+                map->entries + last,
+                n * sizeof(*map->entries));
+            map->size -= last - dst;
+            taa_asset_map_publish(map);
+        }
+    }
+    taa_SPINLOCK_UNLOCK(&map->writelock);
+}
+
+//****************************************************************************
+void taa_asset_remove(
+    taa_asset_map* map,
+    const taa_asset_key key)
+{
+    uint64_t k = taa_asset_map_order(key.parts.group, key.parts.file);
+    uint32_t i;
+    taa_SPINLOCK_LOCK(&map->writelock);
+    i = taa_asset_map_search(map->keys, map->size, k);
+    if(i < map->size && map->keys[i] == k)
+    {
+        // the entry is retired rather than freed, since readers may still
+        // be using its value
+        taa_asset_map_entry* entry = map->entries[i];
+        uint32_t n = map->size - i - 1;
+        memmove(map->keys + i, map->keys + i + 1, n*sizeof(*map->keys));
+        memmove(map->entries+i, map->entries+i+1, n*sizeof(*map->entries));
+        --map->size;
+        entry->next = map->retiredentries[map->epoch & 1];
+        map->retiredentries[map->epoch & 1] = entry;
+        taa_asset_map_publish(map);
     }
-    map->size += n;
-    assert(map->size == total);
+    taa_SPINLOCK_UNLOCK(&map->writelock);
 }
@@ -0,0 +1,1081 @@
+/**
+ * @brief     asset file storage in packed archives implementation
+ * @author    Thomas Atwood (tatwood.net)
+ * @date      2011
+ * @copyright unlicense / public domain
+ ****************************************************************************/
+#include <taa/assetpack.h>
+#include <taa/assetlz.h>
+#include <taa/log.h>
+#include <taa/system.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// on linux, packs are read with pread through a descriptor that remains
+// open, and may be memory mapped. elsewhere, each batch of requests is read
+// through its own stdio handle.
+#if defined(__linux__)
+#define taa_ASSETPACK_POSIX
+#endif
+
+#ifdef taa_ASSETPACK_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// the stdio path seeks with 64 bit offsets, since long may only be 32 bits
+#if !defined(taa_ASSETPACK_POSIX) && defined(_WIN32)
+#define taa_ASSETPACK_FSEEK(fp_, off_) \
+    _fseeki64((fp_), (__int64) (off_), SEEK_SET)
+#elif !defined(taa_ASSETPACK_POSIX)
+#define taa_ASSETPACK_FSEEK(fp_, off_) \
+    fseeko((fp_), (off_t) (off_), SEEK_SET)
+#endif
+
+typedef struct taa_assetpack_s taa_assetpack;
+typedef struct taa_assetpack_block_s taa_assetpack_block;
+typedef struct taa_assetpack_inflate_s taa_assetpack_inflate;
+typedef struct taa_assetpack_read_s taa_assetpack_read;
+typedef struct taa_assetpack_span_s taa_assetpack_span;
+
+enum
+{
+    // the largest number of unrequested bytes that may be read to join the
+    // ranges of two requests into a single read
+    taa_ASSETPACK_MERGE_GAP = 64 * 1024,
+    // the largest read that requests are merged into
+    taa_ASSETPACK_MERGE_MAX = 4 * 1024 * 1024
+};
+
+//****************************************************************************
+// structs
+
+struct taa_assetpack_s
+{
+    taa_asset_group group;
+    taa_asset_pack_storage* mgr;
+    // the table of contents entry of each file in the group
+    const taa_asset_pack_entry* entries;
+    uint32_t blocksize;
+    const char* path;
+#ifdef taa_ASSETPACK_POSIX
+    int fd;
+    // the mapping of the entire pack, or NULL if it is not mapped
+    const unsigned char* base;
+    size_t size;
+#endif
+    taa_assetpack* next;
+};
+
+struct taa_asset_pack_storage_s
+{
+    taa_assetpack* packs;
+    // the queue on which compressed blocks are decompressed, or NULL
+    taa_workqueue* workqueue;
+    uint32_t flags;
+};
+
+// the header of a buffer filled by a single read, which may be shared by
+// the requests for several files. the data follows the header, and the
+// buffer is freed when every request has released it.
+struct taa_assetpack_read_s
+{
+    int32_t refs;
+};
+
+// the range of the pack to read for a request
+struct taa_assetpack_span_s
+{
+    taa_asset_file_request* req;
+    uint64_t start;
+    uint64_t end;
+    // the block table of a compressed file, if it was read separately
+    unsigned char* table;
+    // the position of the request in the batch, which keeps sorting stable
+    uint32_t index;
+};
+
+// a block of a compressed file that is decompressed as a separate task
+struct taa_assetpack_block_s
+{
+    taa_assetpack_inflate* inflate;
+    const unsigned char* src;
+    // the size from the block table, including the stored flag
+    uint32_t srcsize;
+    uint32_t dstoffset;
+};
+
+// tracks the decompression of a file. the decompressed data is allocated in
+// the same buffer, which is freed when the data is released.
+struct taa_assetpack_inflate_s
+{
+    taa_asset_file_request* req;
+    // called once the compressed data is no longer needed, if not NULL
+    taa_asset_release_func srcrelease;
+    void* srcreleasedata;
+    unsigned char* dst;
+    // the offset within the file of the first decompressed byte
+    uint32_t fileoffset;
+    uint32_t blocksize;
+    // the number of blocks that have not been decompressed
+    int32_t remaining;
+    int32_t failed;
+};
+
+//****************************************************************************
+// verifies that the table of contents of a pack is consistent with the size
+// of the pack and is sorted without duplicates. returns zero if not.
+static int taa_assetpack_validate(
+    const taa_asset_pack_header* header,
+    const taa_asset_pack_entry* entries,
+    const char* names,
+    uint64_t packsize)
+{
+    const taa_asset_pack_entry* entry = entries;
+    const taa_asset_pack_entry* entryend = entry + header->numentries;
+    const taa_asset_pack_entry* prev = NULL;
+    int result = 1;
+    if(header->namessize == 0 || names[header->namessize - 1] != '\0')
+    {
+        result = 0;
+    }
+    while(result && entry != entryend)
+    {
+        int compressed = (entry->flags & taa_ASSETPACK_ENTRY_COMPRESSED);
+        if(entry->nameoffset >= header->namessize ||
+           entry->offset < header->dataoffset ||
+           entry->offset > packsize ||
+           entry->storedsize > packsize - entry->offset ||
+           entry->offset + entry->storedsize > (uintptr_t) -1)
+        {
+            result = 0;
+        }
+        else if(compressed ? header->blocksize == 0 :
+                             entry->storedsize != entry->size)
+        {
+            result = 0;
+        }
+        else if(prev != NULL &&
+            (entry->typekey < prev->typekey ||
+            (entry->typekey == prev->typekey &&
+             entry->filekey <= prev->filekey)))
+        {
+            result = 0;
+        }
+        prev = entry;
+        ++entry;
+    }
+    return result;
+}
+
+//****************************************************************************
+// creates a group for a pack once its table of contents has been validated.
+// the size of extra is reserved at the end of the buffer.
+static taa_assetpack* taa_assetpack_create(
+    taa_asset_pack_storage* mgr,
+    const char* name,
+    uint32_t numfiles,
+    size_t extrasize,
+    void** extra_out)
+{
+    uint32_t namesize = strlen(name) + 1;
+    uintptr_t offset;
+    taa_assetpack* pack;
+    taa_asset_file* files;
+    char* groupname;
+    unsigned char* extra;
+    // determine buffer size and pointer offsets
+    offset = 0;
+    pack = (taa_assetpack*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (pack + 1);
+    files = (taa_asset_file*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (files + numfiles);
+    extra = (unsigned char*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (extra + extrasize);
+    groupname = (char*) offset;
+    offset = (uintptr_t) (groupname + namesize);
+    // allocate the buffer and adjust pointers
+    offset = (uintptr_t) calloc(offset, 1);
+    pack = (taa_assetpack*) (((uintptr_t) pack) + offset);
+    files = (taa_asset_file*) (((uintptr_t) files) + offset);
+    extra = (unsigned char*) (((uintptr_t) extra) + offset);
+    groupname = (char*) (((uintptr_t) groupname) + offset);
+    memcpy(groupname, name, namesize);
+    pack->mgr = mgr;
+    pack->group.name = groupname;
+    pack->group.key = taa_asset_gen_groupkey(name);
+    pack->group.numfiles = numfiles;
+    pack->group.files = files;
+    *extra_out = extra;
+    return pack;
+}
+
+//****************************************************************************
+// fills in the file table of a group from the table of contents
+static void taa_assetpack_set_files(
+    taa_assetpack* pack,
+    const taa_asset_pack_entry* entries,
+    const char* names)
+{
+    taa_asset_file* file = pack->group.files;
+    taa_asset_file* fileend = file + pack->group.numfiles;
+    const taa_asset_pack_entry* entry = entries;
+    pack->entries = entries;
+    while(file != fileend)
+    {
+        file->name = names + entry->nameoffset;
+        file->typekey = entry->typekey;
+        file->filekey = entry->filekey;
+        file->size = entry->size;
+        file->handle = (uintptr_t) entry->offset;
+        ++entry;
+        ++file;
+    }
+}
+
+//****************************************************************************
+// determines the range of the pack that must be read for a request. for a
+// compressed file, this is the range of the blocks that hold the requested
+// bytes, which is found from the block table of the file. returns zero if
+// the block table is corrupt.
+static int taa_assetpack_stored_range(
+    taa_assetpack* pack,
+    const taa_asset_file_request* req,
+    const unsigned char* table,
+    uint64_t* start_out,
+    uint64_t* end_out)
+{
+    const taa_asset_pack_entry* entry;
+    uint64_t start;
+    uint64_t end;
+    int ok = 1;
+    entry = pack->entries + (req->file - pack->group.files);
+    if((entry->flags & taa_ASSETPACK_ENTRY_COMPRESSED) != 0)
+    {
+        uint64_t blocksize = pack->blocksize;
+        uint32_t numblocks;
+        uint32_t first = (uint32_t) (req->offset / blocksize);
+        uint32_t last;
+        uint64_t skip = 0;
+        uint64_t span = 0;
+        uint32_t i;
+        numblocks = (uint32_t) ((entry->size + blocksize - 1) / blocksize);
+        last = (uint32_t)
+            ((req->offset + (uint64_t) req->length + blocksize - 1) /
+            blocksize);
+        ok = (numblocks <= entry->storedsize / sizeof(uint32_t));
+        // sum the sizes of the blocks before and within the range
+        for(i = 0; ok && i < last; ++i)
+        {
+            uint32_t blocksrcsize;
+            memcpy(&blocksrcsize, table + i*sizeof(uint32_t), 4);
+            blocksrcsize &= ~taa_ASSETPACK_BLOCK_STORED;
+            if(i < first)
+            {
+                skip += blocksrcsize;
+            }
+            else
+            {
+                span += blocksrcsize;
+            }
+        }
+        start = entry->offset + numblocks*sizeof(uint32_t) + skip;
+        end = start + span;
+        ok = ok && end <= entry->offset + entry->storedsize;
+    }
+    else
+    {
+        start = entry->offset + req->offset;
+        end = start + req->length;
+    }
+    *start_out = start;
+    *end_out = end;
+    return ok;
+}
+
+//****************************************************************************
+// hands the decompressed data of a file to the storage once every block has
+// been processed
+static void taa_assetpack_inflate_finish(
+    taa_assetpack_inflate* inflate)
+{
+    taa_asset_file_request* req = inflate->req;
+    if(inflate->srcrelease != NULL)
+    {
+        inflate->srcrelease(inflate->srcreleasedata);
+    }
+    if(!inflate->failed)
+    {
+        taa_asset_complete_request(
+            req,
+            inflate->dst + (req->offset - inflate->fileoffset),
+            req->length,
+            free,
+            inflate);
+    }
+    else
+    {
+        taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+        free(inflate);
+    }
+}
+
+//****************************************************************************
+// decompresses a single block of a file. called on a workqueue thread.
+static void taa_assetpack_inflate_block(
+    void* userdata)
+{
+    taa_assetpack_block* block = (taa_assetpack_block*) userdata;
+    taa_assetpack_inflate* inflate = block->inflate;
+    uint32_t fileoffset = inflate->fileoffset + block->dstoffset;
+    uint32_t size = inflate->req->file->size - fileoffset;
+    if(size > inflate->blocksize)
+    {
+        size = inflate->blocksize;
+    }
+    // once any block has failed or the request has been cancelled, the
+    // remaining blocks are not needed
+    if(!inflate->failed && !taa_asset_is_request_cancelled(inflate->req))
+    {
+        unsigned char* dst = inflate->dst + block->dstoffset;
+        uint32_t srcsize = block->srcsize & ~taa_ASSETPACK_BLOCK_STORED;
+        int ok;
+        if((block->srcsize & taa_ASSETPACK_BLOCK_STORED) != 0)
+        {
+            ok = (srcsize == size);
+            if(ok)
+            {
+                memcpy(dst, block->src, size);
+            }
+        }
+        else
+        {
+            ok = taa_asset_lz_decompress(block->src, srcsize, dst, size);
+        }
+        if(!ok)
+        {
+            inflate->failed = 1;
+        }
+    }
+    if(taa_ATOMIC_DEC_32(&inflate->remaining) == 0)
+    {
+        taa_assetpack_inflate_finish(inflate);
+    }
+}
+
+//****************************************************************************
+// starts decompressing the blocks of a file that hold the requested range.
+// table is the block table of the file, and src is the compressed data of
+// the first of the blocks. each block is pushed to the decompression
+// workqueue of the storage so that the blocks of a large file are processed
+// in parallel. without a workqueue, the blocks are decompressed immediately
+// on the storage thread. the request is completed once the last block is
+// done, which delivers it to its own queue. if srcrelease is not
+// NULL, it is called once the compressed data is no longer needed. the
+// table is not referenced after this function returns.
+static void taa_assetpack_inflate_file(
+    taa_assetpack* pack,
+    taa_asset_file_request* req,
+    const unsigned char* table,
+    const unsigned char* src,
+    size_t srcsize,
+    taa_asset_release_func srcrelease,
+    void* srcreleasedata)
+{
+    uint64_t blocksize = pack->blocksize;
+    uint32_t first = (uint32_t) (req->offset / blocksize);
+    uint32_t last;
+    uint32_t numblocks;
+    uint32_t fileoffset = (uint32_t) (first * blocksize);
+    uint64_t dstsize;
+    const unsigned char* srcitr = src;
+    const unsigned char* srcend = src + srcsize;
+    taa_workqueue* wq = pack->mgr->workqueue;
+    taa_assetpack_inflate* inflate;
+    taa_assetpack_block* blocks;
+    uintptr_t offset;
+    unsigned char* dst;
+    uint32_t i;
+    last = (uint32_t)
+        ((req->offset + (uint64_t) req->length + blocksize - 1) / blocksize);
+    numblocks = last - first;
+    // the last block of the file may be smaller than the block size
+    dstsize = numblocks * blocksize;
+    if(dstsize > req->file->size - fileoffset)
+    {
+        dstsize = req->file->size - fileoffset;
+    }
+    // determine buffer size and pointer offsets
+    offset = 0;
+    inflate = (taa_assetpack_inflate*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (inflate + 1);
+    blocks = (taa_assetpack_block*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (blocks + numblocks);
+    dst = (unsigned char*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (dst + dstsize);
+    // allocate the buffer and adjust pointers
+    offset = (uintptr_t) malloc(offset);
+    inflate = (taa_assetpack_inflate*) (((uintptr_t) inflate) + offset);
+    blocks = (taa_assetpack_block*) (((uintptr_t) blocks) + offset);
+    dst = (unsigned char*) (((uintptr_t) dst) + offset);
+    inflate->req = req;
+    inflate->srcrelease = srcrelease;
+    inflate->srcreleasedata = srcreleasedata;
+    inflate->dst = dst;
+    inflate->fileoffset = fileoffset;
+    inflate->blocksize = (uint32_t) blocksize;
+    inflate->remaining = (int32_t) numblocks;
+    inflate->failed = 0;
+    // locate the compressed data of each block from the block table
+    for(i = 0; inflate != NULL && i < numblocks; ++i)
+    {
+        uint32_t blocksrcsize;
+        memcpy(&blocks[i].srcsize, table + (first + i)*sizeof(uint32_t), 4);
+        blocksrcsize = blocks[i].srcsize & ~taa_ASSETPACK_BLOCK_STORED;
+        blocks[i].inflate = inflate;
+        blocks[i].src = srcitr;
+        blocks[i].dstoffset = (uint32_t) (i * blocksize);
+        if(blocksrcsize > (uint32_t) (srcend - srcitr))
+        {
+            free(inflate);
+            inflate = NULL;
+        }
+        else
+        {
+            srcitr += blocksrcsize;
+        }
+    }
+    if(inflate == NULL)
+    {
+        // the block table is corrupt
+        if(srcrelease != NULL)
+        {
+            srcrelease(srcreleasedata);
+        }
+        taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+    }
+    else if(numblocks == 0)
+    {
+        taa_assetpack_inflate_finish(inflate);
+    }
+    else
+    {
+        // the inflate buffer may be freed as soon as the last block is done
+        for(i = 0; i < numblocks; ++i)
+        {
+            if(wq != NULL)
+            {
+                taa_workqueue_push(wq, taa_assetpack_inflate_block, blocks+i);
+            }
+            else
+            {
+                taa_assetpack_inflate_block(blocks + i);
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// hands the stored data of a request to the storage, decompressing it first
+// if the file is compressed. data is the range given by stored_range, and
+// table is the block table of a compressed file. the release function is
+// called once the data is not needed.
+static void taa_assetpack_complete(
+    taa_assetpack* pack,
+    taa_asset_file_request* req,
+    const unsigned char* table,
+    const unsigned char* data,
+    size_t size,
+    taa_asset_release_func release,
+    void* releasedata)
+{
+    if(table != NULL)
+    {
+        taa_assetpack_inflate_file(
+            pack,
+            req,
+            table,
+            data,
+            size,
+            release,
+            releasedata);
+    }
+    else
+    {
+        taa_asset_complete_request(req, data, size, release, releasedata);
+    }
+}
+
+//****************************************************************************
+// orders a list of requests by the position of the requested data within
+// the pack with a stable merge sort, so that the pack is read from front to
+// back
+static taa_asset_file_request* taa_assetpack_sort(
+    taa_asset_file_request* requests)
+{
+    taa_asset_file_request* sorted = requests;
+    if(requests != NULL && requests->next != NULL)
+    {
+        taa_asset_file_request* a = requests;
+        taa_asset_file_request* b;
+        taa_asset_file_request* mid = requests;
+        taa_asset_file_request* fast = requests->next;
+        taa_asset_file_request** tail = &sorted;
+        // split the list in half and sort each half
+        while(fast != NULL && fast->next != NULL)
+        {
+            mid = mid->next;
+            fast = fast->next->next;
+        }
+        b = mid->next;
+        mid->next = NULL;
+        a = taa_assetpack_sort(a);
+        b = taa_assetpack_sort(b);
+        // merge the halves, taking from the first half on ties
+        while(a != NULL && b != NULL)
+        {
+            uint64_t akey = a->file->handle + (uint64_t) a->offset;
+            uint64_t bkey = b->file->handle + (uint64_t) b->offset;
+            if(bkey < akey)
+            {
+                *tail = b;
+                b = b->next;
+            }
+            else
+            {
+                *tail = a;
+                a = a->next;
+            }
+            tail = &(*tail)->next;
+        }
+        *tail = (a != NULL) ? a : b;
+    }
+    return sorted;
+}
+
+//****************************************************************************
+// orders spans by the start of their range, and then by their original
+// position so that the order is stable
+static int taa_assetpack_compare_spans(
+    const void* a,
+    const void* b)
+{
+    const taa_assetpack_span* sa = (const taa_assetpack_span*) a;
+    const taa_assetpack_span* sb = (const taa_assetpack_span*) b;
+    int result;
+    if(sa->start != sb->start)
+    {
+        result = (sa->start < sb->start) ? -1 : 1;
+    }
+    else
+    {
+        result = (sa->index < sb->index) ? -1 : (sa->index > sb->index);
+    }
+    return result;
+}
+
+//****************************************************************************
+// releases a reference to a shared read buffer
+static void taa_assetpack_release_read(
+    void* userdata)
+{
+    taa_assetpack_read* read = (taa_assetpack_read*) userdata;
+    if(taa_ATOMIC_DEC_32(&read->refs) == 0)
+    {
+        free(read);
+    }
+}
+
+//****************************************************************************
+// reads a range of bytes from the pack. returns zero if the read failed.
+static int taa_assetpack_read_range(
+    taa_assetpack* pack,
+    FILE* fp,
+    uint64_t offset,
+    size_t size,
+    unsigned char* dst)
+{
+    int ok = 1;
+#ifdef taa_ASSETPACK_POSIX
+    // the pack is read through its descriptor instead of a stdio handle
+    (void) fp;
+    // pread may return fewer bytes than requested
+    while(ok && size > 0)
+    {
+        ssize_t n = pread(pack->fd, dst, size, (off_t) offset);
+        ok = (n > 0);
+        if(ok)
+        {
+            dst += n;
+            offset += n;
+            size -= n;
+        }
+    }
+#else
+    // the pack is read through the stdio handle of the batch
+    (void) pack;
+    ok = (fp != NULL);
+    if(ok && size > 0)
+    {
+        ok = taa_ASSETPACK_FSEEK(fp, offset) == 0 &&
+             fread(dst, 1, size, fp) == size;
+    }
+#endif
+    return ok;
+}
+
+//****************************************************************************
+// determines the range of the pack to read for a request. when only part of
+// a compressed file is requested, its block table is read first to locate
+// the blocks that are needed. otherwise the whole stored file is read and
+// the table is found at the start of the data. returns zero if the range
+// could not be determined.
+static int taa_assetpack_span_request(
+    taa_assetpack* pack,
+    FILE* fp,
+    taa_asset_file_request* req,
+    taa_assetpack_span* span)
+{
+    const taa_asset_pack_entry* entry;
+    int ok = 1;
+    entry = pack->entries + (req->file - pack->group.files);
+    span->req = req;
+    span->table = NULL;
+    if((entry->flags & taa_ASSETPACK_ENTRY_COMPRESSED) == 0)
+    {
+        ok = taa_assetpack_stored_range(
+            pack,
+            req,
+            NULL,
+            &span->start,
+            &span->end);
+    }
+    else if(req->offset == 0 && req->length == entry->size)
+    {
+        span->start = entry->offset;
+        span->end = entry->offset + entry->storedsize;
+    }
+    else
+    {
+        uint64_t blocksize = pack->blocksize;
+        uint64_t numblocks = (entry->size + blocksize - 1) / blocksize;
+        size_t tablesize = (size_t) (numblocks * sizeof(uint32_t));
+        ok = (tablesize <= entry->storedsize);
+        if(ok)
+        {
+            span->table = (unsigned char*) malloc(tablesize + 1);
+            ok = taa_assetpack_read_range(
+                pack,
+                fp,
+                entry->offset,
+                tablesize,
+                span->table);
+        }
+        ok = ok && taa_assetpack_stored_range(
+            pack,
+            req,
+            span->table,
+            &span->start,
+            &span->end);
+        if(!ok)
+        {
+            free(span->table);
+            span->table = NULL;
+        }
+    }
+    return ok;
+}
+
+//****************************************************************************
+// reads the data for a list of requests in order of their position in the
+// pack. requests for nearby data may be merged into a single read, in which
+// case they share a buffer that is freed once every request has released
+// its data.
+static void taa_assetpack_read_requests(
+    taa_assetpack* pack,
+    FILE* fp,
+    taa_asset_file_request* requests)
+{
+    int merge = (pack->mgr->flags & taa_ASSETPACK_MERGE_READS) != 0;
+    taa_asset_file_request* req = requests;
+    taa_assetpack_span* spans;
+    uint32_t numspans = 0;
+    uint32_t n = 0;
+    uint32_t i;
+    while(req != NULL)
+    {
+        ++n;
+        req = req->next;
+    }
+    spans = (taa_assetpack_span*) malloc(n * sizeof(*spans));
+    req = requests;
+    while(req != NULL)
+    {
+        // the request may be released once it is completed
+        taa_asset_file_request* next = req->next;
+        taa_assetpack_span* span = spans + numspans;
+        span->index = numspans;
+        if(taa_assetpack_span_request(pack, fp, req, span))
+        {
+            ++numspans;
+        }
+        else
+        {
+            taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+        }
+        req = next;
+    }
+    // ranges within a compressed file may not be in the order of the files
+    qsort(spans, numspans, sizeof(*spans), taa_assetpack_compare_spans);
+    i = 0;
+    while(i < numspans)
+    {
+        taa_assetpack_read* read;
+        unsigned char* data;
+        uint64_t start = spans[i].start;
+        uint64_t end = spans[i].end;
+        uint32_t runend = i + 1;
+        int extend = merge;
+        uintptr_t offset;
+        // extend the read to cover the following ranges while the gap to
+        // the next range is small and the read has not grown too large
+        while(extend && runend < numspans)
+        {
+            uint64_t nextstart = spans[runend].start;
+            uint64_t nextend = spans[runend].end;
+            nextend = (nextend > end) ? nextend : end;
+            if(nextstart <= end + taa_ASSETPACK_MERGE_GAP &&
+               nextend - start <= taa_ASSETPACK_MERGE_MAX)
+            {
+                end = nextend;
+                ++runend;
+            }
+            else
+            {
+                extend = 0;
+            }
+        }
+        // determine buffer size and pointer offsets
+        offset = 0;
+        read = (taa_assetpack_read*) taa_ALIGN_PTR(offset, 8);
+        offset = (uintptr_t) (read + 1);
+        data = (unsigned char*) taa_ALIGN_PTR(offset, 8);
+        offset = (uintptr_t) (data + (end - start) + 1);
+        // allocate the buffer and adjust pointers
+        offset = (uintptr_t) malloc(offset);
+        read = (taa_assetpack_read*) (((uintptr_t) read) + offset);
+        data = (unsigned char*) (((uintptr_t) data) + offset);
+        read->refs = (int32_t) (runend - i);
+        if(taa_assetpack_read_range(pack, fp, start, end - start, data))
+        {
+            while(i < runend)
+            {
+                taa_assetpack_span* span = spans + i;
+                taa_asset_file_request* spanreq = span->req;
+                const taa_asset_pack_entry* entry;
+                const unsigned char* table = span->table;
+                uint64_t spanstart = span->start;
+                uint64_t spanend = span->end;
+                int ok = 1;
+                entry = pack->entries + (spanreq->file - pack->group.files);
+                if(table == NULL &&
+                   (entry->flags & taa_ASSETPACK_ENTRY_COMPRESSED) != 0)
+                {
+                    // the whole file was read, including its block table
+                    table = data + (spanstart - start);
+                    ok = taa_assetpack_stored_range(
+                        pack,
+                        spanreq,
+                        table,
+                        &spanstart,
+                        &spanend);
+                }
+                if(ok)
+                {
+                    taa_assetpack_complete(
+                        pack,
+                        spanreq,
+                        table,
+                        data + (spanstart - start),
+                        (size_t) (spanend - spanstart),
+                        taa_assetpack_release_read,
+                        read);
+                }
+                else
+                {
+                    taa_assetpack_release_read(read);
+                    taa_asset_complete_request(spanreq, NULL, 0, NULL, NULL);
+                }
+                free(span->table);
+                ++i;
+            }
+        }
+        else
+        {
+            free(read);
+            while(i < runend)
+            {
+                free(spans[i].table);
+                taa_asset_complete_request(spans[i].req, NULL, 0, NULL, NULL);
+                ++i;
+            }
+        }
+    }
+    free(spans);
+}
+
+#ifdef taa_ASSETPACK_POSIX
+
+//****************************************************************************
+// returns the block table of a compressed file in a mapped pack, or NULL if
+// the file is not compressed
+static const unsigned char* taa_assetpack_mapped_table(
+    taa_assetpack* pack,
+    const taa_asset_file_request* req)
+{
+    const taa_asset_pack_entry* entry;
+    const unsigned char* table = NULL;
+    entry = pack->entries + (req->file - pack->group.files);
+    if((entry->flags & taa_ASSETPACK_ENTRY_COMPRESSED) != 0)
+    {
+        table = pack->base + entry->offset;
+    }
+    return table;
+}
+
+#endif // taa_ASSETPACK_POSIX
+
+//****************************************************************************
+// called on the storage thread to load the contents of a set of files. the
+// requests are sorted by offset first, so the pack is read sequentially.
+static void taa_assetpack_load(
+    taa_asset_group* group,
+    taa_asset_file_request* requests)
+{
+    taa_assetpack* pack = (taa_assetpack*) group;
+    taa_asset_file_request* pending = NULL;
+    taa_asset_file_request** pendingtail = &pending;
+    taa_asset_file_request* req = taa_assetpack_sort(requests);
+    FILE* fp = NULL;
+    // cancelled requests are completed immediately and are not read
+    while(req != NULL)
+    {
+        taa_asset_file_request* next = req->next;
+        if(taa_asset_is_request_cancelled(req))
+        {
+            taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+        }
+        else
+        {
+            req->next = NULL;
+            *pendingtail = req;
+            pendingtail = &req->next;
+        }
+        req = next;
+    }
+#ifdef taa_ASSETPACK_POSIX
+    if(pack->base != NULL)
+    {
+        uintptr_t pagemask = (uintptr_t) sysconf(_SC_PAGESIZE) - 1;
+        // start read ahead for every file in the batch before any are
+        // completed
+        req = pending;
+        while(req != NULL)
+        {
+            const unsigned char* table;
+            uint64_t start;
+            uint64_t end;
+            table = taa_assetpack_mapped_table(pack, req);
+            if(taa_assetpack_stored_range(pack, req, table, &start, &end) &&
+               end > start)
+            {
+                uintptr_t p = ((uintptr_t) (pack->base + start)) & ~pagemask;
+                uintptr_t pend = (uintptr_t) (pack->base + end);
+                madvise((void*) p, pend - p, MADV_WILLNEED);
+            }
+            req = req->next;
+        }
+        req = pending;
+        while(req != NULL)
+        {
+            // the request may be released once it is completed
+            taa_asset_file_request* next = req->next;
+            const unsigned char* table;
+            uint64_t start;
+            uint64_t end;
+            table = taa_assetpack_mapped_table(pack, req);
+            if(taa_assetpack_stored_range(pack, req, table, &start, &end))
+            {
+                // the mapping remains valid until the storage is destroyed
+                taa_assetpack_complete(
+                    pack,
+                    req,
+                    table,
+                    pack->base + start,
+                    (size_t) (end - start),
+                    NULL,
+                    NULL);
+            }
+            else
+            {
+                taa_asset_complete_request(req, NULL, 0, NULL, NULL);
+            }
+            req = next;
+        }
+        pending = NULL;
+    }
+#else
+    if(pending != NULL)
+    {
+        // the pack is opened once for the entire batch
+        fp = fopen(pack->path, "rb");
+    }
+#endif
+    if(pending != NULL)
+    {
+        taa_assetpack_read_requests(pack, fp, pending);
+    }
+    if(fp != NULL)
+    {
+        fclose(fp);
+    }
+}
+
+//****************************************************************************
+taa_asset_group* taa_asset_open_pack(
+    taa_asset_pack_storage* mgr,
+    const char* name,
+    const char* path)
+{
+    taa_assetpack* pack = NULL;
+    struct taa_stat stat;
+    FILE* fp = NULL;
+    if(taa_stat(path, &stat) == 0 && stat.st_mode == taa_S_IFREG)
+    {
+        fp = fopen(path, "rb");
+    }
+    if(fp != NULL)
+    {
+        taa_asset_pack_header header;
+        uint64_t packsize = (uint64_t) stat.st_size;
+        size_t tocsize = 0;
+        if(fread(&header, sizeof(header), 1, fp) == 1 &&
+           header.magic == taa_ASSETPACK_MAGIC &&
+           header.version == taa_ASSETPACK_VERSION &&
+           header.numentries < packsize / sizeof(taa_asset_pack_entry))
+        {
+            tocsize = header.numentries * sizeof(taa_asset_pack_entry);
+            tocsize += header.namessize;
+        }
+        if(tocsize > 0 && sizeof(header) + tocsize <= packsize)
+        {
+            uint32_t pathsize = strlen(path) + 1;
+            unsigned char* extra;
+            taa_asset_pack_entry* entries;
+            char* names;
+            int ok;
+            // the table of contents and names are read with a single call
+            // into the group buffer, followed by a copy of the path
+            pack = taa_assetpack_create(
+                mgr,
+                name,
+                header.numentries,
+                tocsize + pathsize,
+                (void**) &extra);
+            entries = (taa_asset_pack_entry*) extra;
+            names = (char*) (entries + header.numentries);
+            ok = fread(extra, 1, tocsize, fp) == tocsize &&
+                 taa_assetpack_validate(&header, entries, names, packsize);
+#ifdef taa_ASSETPACK_POSIX
+            pack->fd = -1;
+            if(ok)
+            {
+                // the descriptor remains open for the lifetime of the group
+                pack->fd = open(path, O_RDONLY | O_CLOEXEC);
+                ok = (pack->fd >= 0);
+            }
+            if(ok &&
+               (mgr->flags & taa_ASSETPACK_MMAP) != 0 &&
+               packsize <= (size_t) -1)
+            {
+                void* base;
+                int prot = PROT_READ;
+                base = mmap(NULL, packsize, prot, MAP_SHARED, pack->fd, 0);
+                if(base != MAP_FAILED)
+                {
+                    pack->base = (const unsigned char*) base;
+                    pack->size = (size_t) packsize;
+                }
+                else
+                {
+                    taa_LOG_WARN("could not map asset pack %s", path);
+                }
+            }
+#endif
+            if(ok)
+            {
+                memcpy(extra + tocsize, path, pathsize);
+                pack->path = (const char*) (extra + tocsize);
+                pack->blocksize = header.blocksize;
+                pack->group.loadfunc = taa_assetpack_load;
+                taa_assetpack_set_files(pack, entries, names);
+                pack->next = mgr->packs;
+                mgr->packs = pack;
+            }
+            else
+            {
+#ifdef taa_ASSETPACK_POSIX
+                if(pack->fd >= 0)
+                {
+                    close(pack->fd);
+                }
+#endif
+                free(pack);
+                pack = NULL;
+            }
+        }
+        fclose(fp);
+    }
+    if(pack == NULL)
+    {
+        taa_LOG_WARN("could not open asset pack %s", path);
+    }
+    return (pack != NULL) ? &pack->group : NULL;
+}
+
+//****************************************************************************
+void taa_asset_create_pack_storage(
+    uint32_t flags,
+    taa_workqueue* wq,
+    taa_asset_pack_storage** mgr_out)
+{
+    taa_asset_pack_storage* mgr;
+    mgr = (taa_asset_pack_storage*) calloc(1, sizeof(*mgr));
+    mgr->workqueue = wq;
+    mgr->flags = flags;
+    *mgr_out = mgr;
+}
+
+//****************************************************************************
+void taa_asset_destroy_pack_storage(
+    taa_asset_pack_storage* mgr)
+{
+    taa_assetpack* pack = mgr->packs;
+    while(pack != NULL)
+    {
+        taa_assetpack* next = pack->next;
+#ifdef taa_ASSETPACK_POSIX
+        if(pack->base != NULL)
+        {
+            munmap((void*) pack->base, pack->size);
+        }
+        close(pack->fd);
+#endif
+        free(pack);
+        pack = next;
+    }
+    free(mgr);
+}
@@ -10,132 +10,921 @@
 #include <taa/semaphore.h>
 #include <taa/spinlock.h>
 #include <taa/thread.h>
+#include <taa/timer.h>
 #include <stdlib.h>
 
+// the request state packs the status into the low bits and the serial number
+// of the request into the remaining bits so that a handle can be validated
+// and the status changed with a single compare and swap.
+#define taa_ASSET_REQUEST_STATUS(s_) ((s_) & 0xf)
+#define taa_ASSET_REQUEST_SERIAL(s_) (((uint32_t) (s_)) >> 4)
+#define taa_ASSET_REQUEST_STATE(serial_, status_) \
+    ((int32_t) ((((uint32_t) (serial_)) << 4) | (status_)))
+
+enum
+{
+    // the maximum number of requests passed to a load function at once
+    // while any request of the group is due. the scheduler reconsiders
+    // which group is most urgent between batches.
+    taa_ASSET_STORAGE_BATCH = 16,
+    // the maximum number of requests passed to a load function at once
+    // while none of the requests of the group are due. the load function
+    // orders the window by position in storage, and the scheduler still
+    // reconsiders between windows so that urgent work is not held up by a
+    // long backlog.
+    taa_ASSET_STORAGE_WINDOW = 256,
+    // the free request pool head stores a 16 bit index and a 16 bit tag
+    taa_ASSET_STORAGE_MAX_POOL = 0xffff
+};
+
+enum taa_asset_request_status_e
+{
+    taa_ASSET_REQUEST_FREE,
+    taa_ASSET_REQUEST_QUEUED,
+    taa_ASSET_REQUEST_LOADING,
+    taa_ASSET_REQUEST_LOADED,
+    taa_ASSET_REQUEST_PARSING,
+    // cancelled individually; the owner is not notified
+    taa_ASSET_REQUEST_CANCELLED,
+    // cancelled with its group; the cancel function will be called
+    taa_ASSET_REQUEST_ABANDONED
+};
+
 typedef struct taa_asset_storage_node_s taa_asset_storage_node;
+typedef struct taa_asset_storage_overflow_s taa_asset_storage_overflow;
+typedef struct taa_asset_storage_worker_s taa_asset_storage_worker;
 
 struct taa_asset_storage_node_s
 {
     taa_asset_group* group;
     taa_asset_file_request* requests;
+    // the earliest deadline of all the requests in the list
+    uint32_t deadline;
+    // set when the request list may no longer be in deadline order
+    int32_t unsorted;
     taa_asset_storage_node* next;
+    // next node in the same hash bucket
+    taa_asset_storage_node* hashnext;
 };
 
-struct taa_asset_storage_s
+struct taa_asset_storage_overflow_s
+{
+    taa_asset_file_request request;
+    taa_asset_storage_overflow* next;
+};
+
+struct taa_asset_storage_worker_s
 {
     taa_thread thread;
+    taa_asset_storage* storage;
+    // the group most recently processed by the thread. requests for the
+    // same group are preferred to keep reads localized.
+    taa_asset_group* group;
+    // the group currently being loaded, or NULL if the thread is idle.
+    // only accessed while the storage lock is held.
+    taa_asset_group* active;
+};
+
+struct taa_asset_storage_s
+{
     taa_semaphore sem;
     int32_t quit;
+    // number of threads that are waiting, or about to wait, on the semaphore
+    int32_t idle;
+    int32_t serial;
+    // lock free stack of submitted requests that have not yet been sorted
+    // into group nodes by a storage thread
+    taa_asset_file_request* inbox;
+    // lock free stack of unused requests. the low 16 bits are the index of
+    // the first request plus one, the high 16 bits are a tag that changes
+    // every time the head changes.
+    int32_t freehead;
+    taa_asset_file_request* requests;
+    uint32_t numrequests;
+    // requests allocated after the pool was exhausted. they are returned to
+    // the overflow pool after use rather than freed so that request handles
+    // never reference released memory.
+    uint32_t overflowlock;
+    taa_asset_file_request* overflowpool;
+    taa_asset_storage_overflow* overflow;
+    int64_t epoch;
+    uint32_t numworkers;
+    taa_asset_storage_worker* workers;
+    // the remaining members are only accessed by the storage threads and
+    // must be protected by the lock
     uint32_t lock;
     taa_asset_storage_node* nodes;
     taa_asset_storage_node* pool;
-    taa_asset_file_request* requestpool;
+    taa_asset_storage_node** buckets;
+    uint32_t bucketmask;
     void* end;
 };
 
+struct taa_asset_completion_queue_s
+{
+    uint32_t lock;
+    // the ring size minus one; the ring size is a power of two
+    uint32_t mask;
+    // free running indices of the next record to drain and to write
+    uint32_t head;
+    uint32_t tail;
+    // requests that finished while the ring was full, in completion order.
+    // records are only written to the ring while this list is empty.
+    taa_asset_file_request* overflow;
+    taa_asset_file_request* overflowtail;
+    taa_asset_completion* records;
+};
+
+//****************************************************************************
+// the time in milliseconds after submission by which a request of each
+// priority class should be serviced. once a deadline has passed, that request
+// is preferred over all work with a later deadline, which prevents requests
+// in the lower priority classes from being starved.
+static const uint32_t taa_asset_storage_budgets[] =
+{
+    0,    // taa_ASSET_PRIORITY_BLOCKING
+    33,   // taa_ASSET_PRIORITY_VISIBLE
+    250,  // taa_ASSET_PRIORITY_NORMAL
+    2000  // taa_ASSET_PRIORITY_SPECULATIVE
+};
+
+//****************************************************************************
+// returns the priority class of a request. values outside the enumeration
+// are treated as the least urgent class so that they cannot index past the
+// end of the budget table.
+static taa_asset_priority taa_asset_storage_priority(
+    taa_asset_priority priority)
+{
+    return ((uint32_t) priority <= taa_ASSET_PRIORITY_SPECULATIVE) ?
+        priority :
+        taa_ASSET_PRIORITY_SPECULATIVE;
+}
+
+//****************************************************************************
+// returns true if deadline a is earlier than deadline b. deadlines are
+// compared by their difference so that the comparison survives wrap around.
+static int taa_asset_storage_before(
+    uint32_t a,
+    uint32_t b)
+{
+    return ((int32_t) (a - b)) < 0;
+}
+
+//****************************************************************************
+// returns the time in milliseconds since the storage instance was created
+static uint32_t taa_asset_storage_now(
+    taa_asset_storage* storage)
+{
+    int64_t t = taa_timer_sample_cpu() - storage->epoch;
+    return (uint32_t) taa_TIMER_NS_TO_MS(t);
+}
+
+//****************************************************************************
+// atomically changes the status of a request from one value to another,
+// preserving its serial number. returns true on success.
+static int taa_asset_storage_transition(
+    taa_asset_file_request* req,
+    int32_t from,
+    int32_t to)
+{
+    int32_t state = req->state;
+    while(taa_ASSET_REQUEST_STATUS(state) == from)
+    {
+        int32_t next = (state & ~0xf) | to;
+        int32_t prev = taa_ATOMIC_CMPXCHG_32(&req->state, next, state);
+        if(prev == state)
+        {
+            return 1;
+        }
+        state = prev;
+    }
+    return 0;
+}
+
+//****************************************************************************
+// wakes one idle storage thread, if there are any
+static void taa_asset_storage_wake(
+    taa_asset_storage* storage)
+{
+    int32_t n = storage->idle;
+    while(n > 0)
+    {
+        int32_t prev = taa_ATOMIC_CMPXCHG_32(&storage->idle, n - 1, n);
+        if(prev == n)
+        {
+            // the idle count was claimed, so exactly one post is owed
+            taa_semaphore_post(&storage->sem);
+            break;
+        }
+        n = prev;
+    }
+}
+
+//****************************************************************************
+// pushes a linked chain of requests onto the submission stack
+static void taa_asset_storage_submit(
+    taa_asset_storage* storage,
+    taa_asset_file_request* first,
+    taa_asset_file_request* last)
+{
+    taa_asset_file_request* head = storage->inbox;
+    while(1)
+    {
+        taa_asset_file_request* prev;
+        last->next = head;
+        prev = (taa_asset_file_request*) taa_ATOMIC_CMPXCHGPTR(
+            (void**) &storage->inbox,
+            first,
+            head);
+        if(prev == head)
+        {
+            break;
+        }
+        head = prev;
+    }
+    taa_asset_storage_wake(storage);
+}
+
+//****************************************************************************
+// takes every request from the submission stack
+static taa_asset_file_request* taa_asset_storage_drain(
+    taa_asset_storage* storage)
+{
+    taa_asset_file_request* head = storage->inbox;
+    while(head != NULL)
+    {
+        taa_asset_file_request* prev;
+        prev = (taa_asset_file_request*) taa_ATOMIC_CMPXCHGPTR(
+            (void**) &storage->inbox,
+            NULL,
+            head);
+        if(prev == head)
+        {
+            break;
+        }
+        head = prev;
+    }
+    return head;
+}
+
+//****************************************************************************
+// pops up to n requests from the lock free pool with a single exchange. the
+// requests are returned as a linked list, and the number taken is returned.
+static uint32_t taa_asset_storage_pop_pool(
+    taa_asset_storage* storage,
+    uint32_t n,
+    taa_asset_file_request** list_out)
+{
+    taa_asset_file_request* reqbegin = storage->requests;
+    taa_asset_file_request* reqend = reqbegin + storage->numrequests;
+    uint32_t head = (uint32_t) storage->freehead;
+    uint32_t count = 0;
+    *list_out = NULL;
+    while(n > 0 && (head & 0xffff) != 0)
+    {
+        taa_asset_file_request* first = reqbegin + (head & 0xffff) - 1;
+        taa_asset_file_request* last = first;
+        taa_asset_file_request* next;
+        uint32_t nexthead = (head + 0x10000) & 0xffff0000;
+        uint32_t prev;
+        // walk to the end of the range to be taken. if another thread pops
+        // any of these requests first, the links may be garbage, but the tag
+        // guarantees the exchange will fail in that case.
+        count = 1;
+        next = last->next;
+        while(count < n && next >= reqbegin && next < reqend)
+        {
+            last = next;
+            next = last->next;
+            ++count;
+        }
+        if(next >= reqbegin && next < reqend)
+        {
+            nexthead |= ((uint32_t) (next - reqbegin)) + 1;
+        }
+        prev = (uint32_t) taa_ATOMIC_CMPXCHG_32(
+            &storage->freehead,
+            (int32_t) nexthead,
+            (int32_t) head);
+        if(prev == head)
+        {
+            last->next = NULL;
+            *list_out = first;
+            break;
+        }
+        head = prev;
+        count = 0;
+    }
+    return count;
+}
+
+//****************************************************************************
+// returns a request to the pool once the storage is finished with it
+static void taa_asset_storage_recycle(
+    taa_asset_file_request* req)
+{
+    taa_asset_storage* storage = req->storage;
+    taa_asset_file_request* reqend = storage->requests + storage->numrequests;
+    req->state = taa_ASSET_REQUEST_STATE(0, taa_ASSET_REQUEST_FREE);
+    if(req >= storage->requests && req < reqend)
+    {
+        uint32_t index = ((uint32_t) (req - storage->requests)) + 1;
+        uint32_t head = (uint32_t) storage->freehead;
+        while(1)
+        {
+            uint32_t nexthead = ((head + 0x10000) & 0xffff0000) | index;
+            uint32_t prev;
+            req->next = NULL;
+            if((head & 0xffff) != 0)
+            {
+                req->next = storage->requests + (head & 0xffff) - 1;
+            }
+            prev = (uint32_t) taa_ATOMIC_CMPXCHG_32(
+                &storage->freehead,
+                (int32_t) nexthead,
+                (int32_t) head);
+            if(prev == head)
+            {
+                break;
+            }
+            head = prev;
+        }
+    }
+    else
+    {
+        taa_SPINLOCK_LOCK(&storage->overflowlock);
+        req->next = storage->overflowpool;
+        storage->overflowpool = req;
+        taa_SPINLOCK_UNLOCK(&storage->overflowlock);
+    }
+}
+
+//****************************************************************************
+// called on one of the workqueue threads to execute the parse function
+static void taa_asset_storage_parse(
+    void* userdata)
+{
+    taa_asset_file_request* req = (taa_asset_file_request*) userdata;
+    if(taa_asset_storage_transition(
+        req,
+        taa_ASSET_REQUEST_LOADED,
+        taa_ASSET_REQUEST_PARSING))
+    {
+        req->parsefunc(req->data, req->size, req->userdata);
+    }
+    else if(taa_ASSET_REQUEST_STATUS(req->state)==taa_ASSET_REQUEST_ABANDONED)
+    {
+        // the request was cancelled along with the rest of its group
+        req->cancelfunc(req->userdata);
+    }
+    if(req->releasefunc != NULL)
+    {
+        // instruct the storage plugin that the data may be reused
+        req->releasefunc(req->releasedata);
+    }
+    taa_asset_storage_recycle(req);
+}
+
+//****************************************************************************
+// initializes a completion record from the current contents of a request
+static void taa_asset_storage_fill_completion(
+    taa_asset_file_request* req,
+    taa_asset_completion* rec)
+{
+    rec->file = req->file;
+    rec->data = req->data;
+    rec->size = req->size;
+    rec->status = (req->data != NULL) ?
+        taa_ASSET_COMPLETION_OK :
+        taa_ASSET_COMPLETION_ERROR;
+    rec->userdata = req->userdata;
+    rec->request = req;
+}
+
+//****************************************************************************
+// appends a finished request to its completion queue
+static void taa_asset_storage_post_completion(
+    taa_asset_file_request* req)
+{
+    taa_asset_completion_queue* cq = req->completionqueue;
+    int full = 0;
+    taa_SPINLOCK_LOCK(&cq->lock);
+    if(cq->overflow == NULL && cq->tail - cq->head <= cq->mask)
+    {
+        taa_asset_completion* rec = cq->records + (cq->tail & cq->mask);
+        taa_asset_storage_fill_completion(req, rec);
+        ++cq->tail;
+    }
+    else
+    {
+        // never block the storage thread; keep the request until drained
+        req->next = NULL;
+        if(cq->overflowtail != NULL)
+        {
+            cq->overflowtail->next = req;
+        }
+        else
+        {
+            cq->overflow = req;
+        }
+        cq->overflowtail = req;
+        full = 1;
+    }
+    taa_SPINLOCK_UNLOCK(&cq->lock);
+    if(full)
+    {
+        taa_LOG_DEBUG("asset completion queue full, deferred to overflow");
+    }
+}
+
+//****************************************************************************
+// hands a loaded or abandoned request on to its consumer, either through its
+// completion queue or by pushing the parse function to its workqueue
+static void taa_asset_storage_deliver(
+    taa_asset_file_request* req)
+{
+    if(req->completionqueue != NULL)
+    {
+        taa_asset_storage_post_completion(req);
+    }
+    else
+    {
+        taa_workqueue_push(req->workqueue, taa_asset_storage_parse, req);
+    }
+}
+
+//****************************************************************************
+// disposes of a cancelled request that is no longer referenced by a queue.
+// if the owner needs to be notified, the request is delivered as usual.
+static void taa_asset_storage_discard(
+    taa_asset_file_request* req)
+{
+    if(taa_ASSET_REQUEST_STATUS(req->state) == taa_ASSET_REQUEST_ABANDONED)
+    {
+        taa_asset_storage_deliver(req);
+    }
+    else
+    {
+        taa_asset_storage_recycle(req);
+    }
+}
+
+//****************************************************************************
+// cancels every request for a group within a range of the request pool that
+// has not started parsing. if the cancel function is not NULL, the requests
+// are marked so that the owner will be notified.
+static void taa_asset_storage_cancel_range(
+    taa_asset_file_request* req,
+    taa_asset_file_request* reqend,
+    taa_asset_group* group,
+    taa_asset_cancel_func cancelfunc)
+{
+    int32_t to = (cancelfunc != NULL) ?
+        taa_ASSET_REQUEST_ABANDONED :
+        taa_ASSET_REQUEST_CANCELLED;
+    while(req != reqend)
+    {
+        // the request may be recycled for another owner at any time, so the
+        // group is only trusted if the serial is unchanged after reading it
+        int32_t state = req->state;
+        int match = (req->group == group);
+        uint32_t serial = taa_ASSET_REQUEST_SERIAL(state);
+        state = req->state;
+        while(match && taa_ASSET_REQUEST_SERIAL(state) == serial)
+        {
+            int32_t status = taa_ASSET_REQUEST_STATUS(state);
+            int32_t prev;
+            if(status != taa_ASSET_REQUEST_QUEUED &&
+               status != taa_ASSET_REQUEST_LOADING &&
+               status != taa_ASSET_REQUEST_LOADED)
+            {
+                break;
+            }
+            // the cancel function must be set before the status changes so
+            // that it is visible to whichever thread discards it. it is only
+            // read if the abandoned status is set by this thread.
+            req->cancelfunc = cancelfunc;
+            prev = taa_ATOMIC_CMPXCHG_32(
+                &req->state,
+                (state & ~0xf) | to,
+                state);
+            match = (prev != state);
+            state = prev;
+        }
+        ++req;
+    }
+}
+//****************************************************************************
+// returns true if a worker other than the one specified is loading the group
+static int taa_asset_storage_is_active(
+    taa_asset_storage* storage,
+    taa_asset_storage_worker* worker,
+    taa_asset_group* group)
+{
+    taa_asset_storage_worker* itr = storage->workers;
+    taa_asset_storage_worker* end = itr + storage->numworkers;
+    while(itr != end)
+    {
+        if(itr != worker && itr->active == group)
+        {
+            return 1;
+        }
+        ++itr;
+    }
+    return 0;
+}
+
+//****************************************************************************
+// stable merge sort of a request list into deadline order
+static taa_asset_file_request* taa_asset_storage_sort(
+    taa_asset_file_request* list)
+{
+    taa_asset_file_request* a;
+    taa_asset_file_request* b;
+    taa_asset_file_request* slow;
+    taa_asset_file_request* fast;
+    taa_asset_file_request** ref;
+    if(list == NULL || list->next == NULL)
+    {
+        return list;
+    }
+    // split the list in half
+    slow = list;
+    fast = list->next;
+    while(fast != NULL && fast->next != NULL)
+    {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    a = list;
+    b = slow->next;
+    slow->next = NULL;
+    a = taa_asset_storage_sort(a);
+    b = taa_asset_storage_sort(b);
+    // merge the sorted halves
+    ref = &list;
+    while(a != NULL && b != NULL)
+    {
+        if(taa_asset_storage_before(b->deadline, a->deadline))
+        {
+            *ref = b;
+            b = b->next;
+        }
+        else
+        {
+            *ref = a;
+            a = a->next;
+        }
+        ref = &(*ref)->next;
+    }
+    *ref = (a != NULL) ? a : b;
+    return list;
+}
+
+//****************************************************************************
+// selects the next node to be processed by a worker. the node with the
+// earliest deadline is preferred, but a worker continues to process the group
+// it previously loaded until work in another group becomes due. groups being
+// loaded by other workers are only selected once they are due. returns the
+// address of the reference to the node, or NULL if nothing is queued.
+static taa_asset_storage_node** taa_asset_storage_select(
+    taa_asset_storage* storage,
+    taa_asset_storage_worker* worker,
+    uint32_t now)
+{
+    taa_asset_storage_node** best = NULL;
+    taa_asset_storage_node** sticky = NULL;
+    taa_asset_storage_node** any = NULL;
+    taa_asset_storage_node** ref = &storage->nodes;
+    while(*ref != NULL)
+    {
+        taa_asset_storage_node* node = *ref;
+        uint32_t deadline = node->deadline;
+        int due = !taa_asset_storage_before(now, deadline);
+        if(node->group == worker->group)
+        {
+            sticky = ref;
+        }
+        if(due || !taa_asset_storage_is_active(storage,worker,node->group))
+        {
+            if(best == NULL ||
+               taa_asset_storage_before(deadline, (*best)->deadline))
+            {
+                best = ref;
+            }
+        }
+        if(any == NULL || taa_asset_storage_before(deadline,(*any)->deadline))
+        {
+            any = ref;
+        }
+        ref = &node->next;
+    }
+    if(sticky != NULL)
+    {
+        // stay with the previous group unless something else is both due
+        // and more urgent
+        if(best == NULL ||
+           taa_asset_storage_before(now, (*best)->deadline) ||
+           !taa_asset_storage_before((*best)->deadline, (*sticky)->deadline))
+        {
+            best = sticky;
+        }
+    }
+    return (best != NULL) ? best : any;
+}
+
+//****************************************************************************
+// finds the queued node for a group. the storage lock must be held.
+static taa_asset_storage_node* taa_asset_storage_find(
+    taa_asset_storage* storage,
+    taa_asset_group* group)
+{
+    uint32_t hash = (uint32_t) (((uintptr_t) group) >> 4);
+    taa_asset_storage_node* node = storage->buckets[hash&storage->bucketmask];
+    while(node != NULL && node->group != group)
+    {
+        node = node->hashnext;
+    }
+    return node;
+}
+
+//****************************************************************************
+// removes a node from the queue and returns it to the pool. the storage lock
+// must be held. if the node is an overflow allocation it is returned so that
+// it may be freed after the lock is released, otherwise NULL is returned.
+static taa_asset_storage_node* taa_asset_storage_unlink(
+    taa_asset_storage* storage,
+    taa_asset_storage_node** ref)
+{
+    taa_asset_storage_node* node = *ref;
+    taa_asset_storage_node** hashref;
+    uint32_t hash = (uint32_t) (((uintptr_t) node->group) >> 4);
+    // remove the node from the schedule list and its hash bucket
+    *ref = node->next;
+    hashref = storage->buckets + (hash & storage->bucketmask);
+    while(*hashref != node)
+    {
+        hashref = &(*hashref)->hashnext;
+    }
+    *hashref = node->hashnext;
+    if(((void*) node) > ((void*) storage) && ((void*) node) < storage->end)
+    {
+        // put the node back in the pool
+        node->next = storage->pool;
+        storage->pool = node;
+        node = NULL;
+    }
+    return node;
+}
+
+//****************************************************************************
+// sorts a list of newly submitted requests into the group nodes. requests
+// that were cancelled while in the submission stack are added to the discard
+// list instead. the storage lock must be held and may be temporarily released
+// if an overflow node must be allocated.
+static void taa_asset_storage_gather(
+    taa_asset_storage* storage,
+    taa_asset_file_request* list,
+    taa_asset_file_request** discard)
+{
+    while(list != NULL)
+    {
+        taa_asset_file_request* req = list;
+        taa_asset_group* group = req->group;
+        taa_asset_storage_node* node;
+        list = req->next;
+        if(taa_ASSET_REQUEST_STATUS(req->state) != taa_ASSET_REQUEST_QUEUED)
+        {
+            req->next = *discard;
+            *discard = req;
+        }
+        else if((node = taa_asset_storage_find(storage, group)) != NULL)
+        {
+            // requests are kept in deadline order, so if the new request is
+            // not at least as urgent as the head, the list must be sorted
+            if(taa_asset_storage_before(
+                node->requests->deadline,
+                req->deadline))
+            {
+                node->unsorted = 1;
+            }
+            if(taa_asset_storage_before(req->deadline, node->deadline))
+            {
+                node->deadline = req->deadline;
+            }
+            req->next = node->requests;
+            node->requests = req;
+        }
+        else
+        {
+            uint32_t hash = (uint32_t) (((uintptr_t) group) >> 4);
+            taa_asset_storage_node** bucket;
+            // no pending requests for the group, need to create a node
+            if(storage->pool != NULL)
+            {
+                node = storage->pool;
+                storage->pool = node->next;
+            }
+            else
+            {
+                // unlock before calling system functions to avoid stalls.
+                // the list is private to this thread, so it is safe to
+                // proceed once relocked.
+                taa_SPINLOCK_UNLOCK(&storage->lock);
+                taa_LOG_WARN(
+                    "asset storage node pool empty, alloced overflow");
+                node = (taa_asset_storage_node*) malloc(sizeof(*node));
+                taa_SPINLOCK_LOCK(&storage->lock);
+                // another thread may have created a node while unlocked
+                if(taa_asset_storage_find(storage, group) != NULL)
+                {
+                    free(node);
+                    list = req;
+                    node = NULL;
+                }
+            }
+            if(node != NULL)
+            {
+                bucket = storage->buckets + (hash & storage->bucketmask);
+                req->next = NULL;
+                node->group = group;
+                node->requests = req;
+                node->deadline = req->deadline;
+                node->unsorted = 0;
+                node->next = storage->nodes;
+                node->hashnext = *bucket;
+                storage->nodes = node;
+                *bucket = node;
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// detaches the most urgent requests of a node to be passed to a load
+// function, in deadline order. when none of them are due, a larger window
+// is detached so that the load function can order more of the list by
+// position in storage; otherwise only a batch is taken so that the scheduler
+// can reconsider the most urgent work sooner. requests cancelled while queued
+// are added to the discard list instead. the node is removed from the queue
+// once it is empty, and if it is an overflow allocation it is returned
+// through ovfnode_out so that it may be freed after the lock is released.
+// the storage lock must be held.
+static taa_asset_file_request* taa_asset_storage_cut(
+    taa_asset_storage* storage,
+    taa_asset_storage_node** ref,
+    uint32_t now,
+    taa_asset_file_request** discard,
+    taa_asset_storage_node** ovfnode_out)
+{
+    taa_asset_storage_node* node = *ref;
+    taa_asset_file_request* batch = NULL;
+    taa_asset_file_request** reqref = &batch;
+    uint32_t maxbatch = taa_ASSET_STORAGE_BATCH;
+    uint32_t n = 0;
+    if(node->unsorted)
+    {
+        node->requests = taa_asset_storage_sort(node->requests);
+        node->unsorted = 0;
+    }
+    if(node->requests != NULL &&
+       taa_asset_storage_before(now, node->requests->deadline))
+    {
+        maxbatch = taa_ASSET_STORAGE_WINDOW;
+    }
+    while(node->requests != NULL && n != maxbatch)
+    {
+        taa_asset_file_request* req = node->requests;
+        node->requests = req->next;
+        if(taa_asset_storage_transition(
+            req,
+            taa_ASSET_REQUEST_QUEUED,
+            taa_ASSET_REQUEST_LOADING))
+        {
+            *reqref = req;
+            reqref = &req->next;
+            ++n;
+        }
+        else
+        {
+            req->next = *discard;
+            *discard = req;
+        }
+    }
+    *reqref = NULL;
+    *ovfnode_out = NULL;
+    if(node->requests != NULL)
+    {
+        // requests remain, so leave the node in the queue
+        node->deadline = node->requests->deadline;
+    }
+    else
+    {
+        // remove the node from the list
+        *ovfnode_out = taa_asset_storage_unlink(storage, ref);
+    }
+    return batch;
+}
+
 //****************************************************************************
 static taa_thread_result taa_THREAD_CALLCONV taa_asset_storage_thread(
     void* userdata)
 {
-    taa_asset_storage* storage = (taa_asset_storage*) userdata;
-    taa_asset_group* group = NULL;
+    taa_asset_storage_worker* worker = (taa_asset_storage_worker*) userdata;
+    taa_asset_storage* storage = worker->storage;
+    int wait;
     // loop until instructed to quit
     while(!storage->quit)
     {
         // loop until there's no more work to do
         while(!storage->quit)
         {
-            // loop through all of the requested group queues to find
-            // the next file list to process. if additional requests exist
-            // for the same group that was previously processed, that
-            // node will be reprocessed, otherwise the group at the front of
-            // the queue is selected.
-            taa_asset_file_request* req;
-            taa_asset_file_request* freelist;
+            taa_asset_group* group;
+            taa_asset_file_request* submitted;
+            taa_asset_file_request* discard;
+            taa_asset_file_request* batch;
             taa_asset_storage_node* node;
-            taa_asset_storage_node* itr;
             taa_asset_storage_node** ref;
-            taa_asset_storage_node** prevref;
+            uint32_t now;
+            int pending;
+            // take everything that has been submitted in one operation
+            submitted = taa_asset_storage_drain(storage);
+            discard = NULL;
+            batch = NULL;
+            now = taa_asset_storage_now(storage);
             // lock
             taa_SPINLOCK_LOCK(&storage->lock);
-            node = storage->nodes;
-            ref = prevref = &storage->nodes;
-            itr = node;
-            while(itr != NULL)
+            taa_asset_storage_gather(storage, submitted, &discard);
+            ref = taa_asset_storage_select(storage, worker, now);
+            node = NULL;
+            group = NULL;
+            if(ref != NULL)
             {
-                if(itr->group == group)
-                {
-                    // if a node exists matching the previously processed
-                    // group, use that node
-                    node = itr;
-                    ref = prevref;
-                    break;
-                }
-                prevref = &itr->next;
-                itr = itr->next;
+                group = (*ref)->group;
+                batch = taa_asset_storage_cut(
+                    storage,
+                    ref,
+                    now,
+                    &discard,
+                    &node);
             }
-            if(node == NULL)
+            worker->active = group;
+            pending = storage->nodes != NULL;
+            taa_SPINLOCK_UNLOCK(&storage->lock);
+            if(node != NULL)
             {
-                // nothing to do
-                taa_SPINLOCK_UNLOCK(&storage->lock);
-                break;
+                // free overflow node after lock is released
+                free(node);
+                taa_LOG_DEBUG("asset storage freed overflow node req");
             }
-            // remove the node from the list
-            *ref = node->next;
-            taa_SPINLOCK_UNLOCK(&storage->lock);
-            // process the file requests; this may take a while
-            // the lock MUST be released at this point
-            group = node->group;
-            req = node->requests;
-            group->loadfunc(group, req);
-            // lock
-            taa_SPINLOCK_LOCK(&storage->lock);
-            freelist = NULL;
-            while(req != NULL)
+            while(discard != NULL)
             {
-                // release the file requests
-                taa_asset_file_request* next = req->next;
-                if(((void*) req) > userdata && ((void*) req) < storage->end)
-                {
-                    req->next = storage->requestpool;
-                    storage->requestpool = req;
-                }
-                else
-                {
-                    // put overflow pointer in free list. to prevent stalls,
-                    // do not call free until lock is released
-                    req->next = freelist;
-                    freelist = req;
-                }
-                req = next;
+                taa_asset_file_request* next = discard->next;
+                taa_asset_storage_discard(discard);
+                discard = next;
             }
-            if(((void*) node) > userdata && ((void*) node) < storage->end)
+            if(group == NULL)
             {
-                // put the node back in the pool
-                node->next = storage->pool;
-                storage->pool = node;
-                node = NULL;
+                // nothing to do
+                break;
             }
-            taa_SPINLOCK_UNLOCK(&storage->lock);
-            if(node != NULL)
+            if(pending)
             {
-                // free overflow node after lock is released
-                free(node);
-                taa_LOG_DEBUG("asset storage freed overflow node req");              
+                // more work remains, so let another thread help with it
+                taa_asset_storage_wake(storage);
             }
-            // free all the overflow requests while lock is released
-            while(freelist != NULL)
+            if(batch != NULL)
             {
-                taa_asset_file_request* next = freelist->next;
-                free(freelist);
-                taa_LOG_DEBUG("asset storage freed overflow file req");
-                freelist = next;
+                // process the file requests; this may take a while
+                // the lock MUST be released at this point. the requests are
+                // released as each one is completed by the load function.
+                worker->group = group;
+                group->loadfunc(group, batch);
             }
             // be polite and yield after releasing the lock
             taa_sched_yield();
         }
-        // if there's nothing to do, sleep until there is
-        taa_semaphore_wait(&storage->sem);
+        // if there's nothing to do, sleep until there is. a thread is only
+        // woken if it has announced that it is idle.
+        taa_ATOMIC_INC_32(&storage->idle);
+        wait = 1;
+        if(storage->inbox != NULL || storage->quit)
+        {
+            // work arrived after the queue was checked. if the idle count
+            // can be withdrawn, go back to work, otherwise a wake is already
+            // owed to this thread and must be consumed.
+            int32_t n = storage->idle;
+            while(n > 0 && wait)
+            {
+                int32_t prev = taa_ATOMIC_CMPXCHG_32(&storage->idle, n-1, n);
+                wait = (prev != n);
+                n = prev;
+            }
+        }
+        if(wait)
+        {
+            taa_semaphore_wait(&storage->sem);
+        }
     }
     return 0;
 }
@@ -144,17 +933,37 @@ static taa_thread_result taa_THREAD_CALLCONV taa_asset_storage_thread(
 void taa_asset_create_storage(
     uint32_t storagecapacity,
     uint32_t reqcapacity,
+    uint32_t numthreads,
     taa_asset_storage** storage_out)
 {
     uintptr_t offset = 0;
     taa_asset_storage* storage;
+    taa_asset_storage_worker* worker;
+    taa_asset_storage_worker* workerend;
+    taa_asset_storage_node** buckets;
     taa_asset_storage_node* node;
     taa_asset_storage_node* nodeend;
     taa_asset_file_request* req;
     taa_asset_file_request* reqend;
+    uint32_t numbuckets;
+    if(reqcapacity > taa_ASSET_STORAGE_MAX_POOL)
+    {
+        taa_LOG_WARN("asset storage request capacity limited to 65535");
+        reqcapacity = taa_ASSET_STORAGE_MAX_POOL;
+    }
+    // use a power of two hash table size with a low load factor
+    numbuckets = 8;
+    while(numbuckets < storagecapacity * 2)
+    {
+        numbuckets <<= 1;
+    }
     // determine buffer size and pointer offsets
     storage = (taa_asset_storage*) offset;
     offset = (uintptr_t) (storage + 1);
+    worker = (taa_asset_storage_worker*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (worker + numthreads);
+    buckets = (taa_asset_storage_node**) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (buckets + numbuckets);
     node = (taa_asset_storage_node*) taa_ALIGN_PTR(offset, 8);
     offset = (uintptr_t) (node + storagecapacity);
     req = (taa_asset_file_request*) taa_ALIGN_PTR(offset, 8);
@@ -162,29 +971,45 @@ void taa_asset_create_storage(
     // allocate the buffer and adjust pointers
     offset = (uintptr_t) calloc(1, offset);
     storage = (taa_asset_storage*) (((uintptr_t) storage) + offset);
+    worker = (taa_asset_storage_worker*) (((uintptr_t) worker) + offset);
+    buckets = (taa_asset_storage_node**) (((uintptr_t) buckets) + offset);
     node = (taa_asset_storage_node*) (((uintptr_t) node) + offset);
     req = (taa_asset_file_request*) (((uintptr_t) req) + offset);
     nodeend = node + storagecapacity;
     reqend = req + reqcapacity;
+    workerend = worker + numthreads;
     // initialize assetstorage struct
-    storage->pool = node;
-    storage->requestpool = req;
+    storage->epoch = taa_timer_sample_cpu();
+    storage->numworkers = numthreads;
+    storage->workers = worker;
+    storage->buckets = buckets;
+    storage->bucketmask = numbuckets - 1;
+    storage->pool = (storagecapacity > 0) ? node : NULL;
+    storage->freehead = (reqcapacity > 0) ? 1 : 0;
+    storage->requests = req;
+    storage->numrequests = reqcapacity;
     storage->end = reqend;
     // initialize node pool
-    while(node != nodeend-1)
+    while(node != nodeend)
     {
-        node->next = node + 1;
+        node->next = (node != nodeend-1) ? node + 1 : NULL;
         ++node;
     }
     // initialize request pool
-    while(req != reqend-1)
+    while(req != reqend)
     {
-        req->next = req + 1;
+        req->storage = storage;
+        req->next = (req != reqend-1) ? req + 1 : NULL;
         ++req;
     }
-    // initialize thread
+    // initialize threads
     taa_semaphore_create(&storage->sem);
-    taa_thread_create(taa_asset_storage_thread, storage, &storage->thread);
+    while(worker != workerend)
+    {
+        worker->storage = storage;
+        taa_thread_create(taa_asset_storage_thread, worker, &worker->thread);
+        ++worker;
+    }
     // set out parameter
     *storage_out = storage;
 }
@@ -194,6 +1019,7 @@ void taa_asset_destroy_storage(
     taa_asset_storage* storage)
 {
     taa_asset_storage_node* node;
+    taa_asset_storage_overflow* ovf;
     // stop the storage thread
     if(!storage->quit)
     {
@@ -205,110 +1031,618 @@ void taa_asset_destroy_storage(
     while(node != NULL)
     {
         taa_asset_storage_node* next = node->next;
-        taa_asset_file_request* req = node->requests;
-        while(req != NULL)
-        {
-            taa_asset_file_request* reqnext = req->next;
-            if(((void*)req) < ((void*)storage) || ((void*)req) > storage->end)
-            {
-                free(req);
-            }
-            req = reqnext;
-        }
         if(((void*)node) < ((void*)storage)|| ((void*)node) > storage->end)
         {
             free(node);
         }
         node = next;
     }
+    ovf = storage->overflow;
+    while(ovf != NULL)
+    {
+        taa_asset_storage_overflow* next = ovf->next;
+        free(ovf);
+        ovf = next;
+    }
     // free the buffer
     free(storage);
 }
 
 //****************************************************************************
-void taa_asset_request_file(
+int taa_asset_cancel_request(
+    taa_asset_storage* storage,
+    taa_asset_request_handle handle)
+{
+    taa_asset_file_request* req = handle.request;
+    int result = 0;
+    // cancelled requests are discarded lazily, so the storage is not needed
+    (void) storage;
+    if(req != NULL)
+    {
+        // queued requests are discarded by the storage threads when they are
+        // next encountered. requests passed to a load function are discarded
+        // by the parse stage.
+        int32_t state = req->state;
+        while(taa_ASSET_REQUEST_SERIAL(state) == handle.serial)
+        {
+            int32_t status = taa_ASSET_REQUEST_STATUS(state);
+            int32_t prev;
+            if(status != taa_ASSET_REQUEST_QUEUED &&
+               status != taa_ASSET_REQUEST_LOADING &&
+               status != taa_ASSET_REQUEST_LOADED)
+            {
+                break;
+            }
+            prev = taa_ATOMIC_CMPXCHG_32(
+                &req->state,
+                (state & ~0xf) | taa_ASSET_REQUEST_CANCELLED,
+                state);
+            if(prev == state)
+            {
+                result = 1;
+                break;
+            }
+            state = prev;
+        }
+    }
+    return result;
+}
+
+//****************************************************************************
+void taa_asset_cancel_group(
     taa_asset_storage* storage,
     taa_asset_group* group,
-    taa_asset_file* file,
-    taa_workqueue* wq,
-    taa_asset_parse_func parsefunc,
-    void* userdata)
+    taa_asset_cancel_func cancelfunc)
 {
     taa_asset_storage_node* node;
-    taa_asset_storage_node* itr;
-    taa_asset_file_request* req;
-    // lock
+    taa_asset_storage_node* ovfnode = NULL;
+    taa_asset_storage_overflow* ovf;
+    taa_asset_file_request* queued = NULL;
+    // mark every outstanding request for the group, whether it is waiting in
+    // the submission stack, queued in a node, or being loaded
+    taa_asset_storage_cancel_range(
+        storage->requests,
+        storage->requests + storage->numrequests,
+        group,
+        cancelfunc);
+    taa_SPINLOCK_LOCK(&storage->overflowlock);
+    ovf = storage->overflow;
+    taa_SPINLOCK_UNLOCK(&storage->overflowlock);
+    while(ovf != NULL)
+    {
+        // overflow allocations are only ever added to the front of the list
+        taa_asset_storage_cancel_range(
+            &ovf->request,
+            &ovf->request + 1,
+            group,
+            cancelfunc);
+        ovf = ovf->next;
+    }
+    // detach the queued node so that its requests are discarded immediately
     taa_SPINLOCK_LOCK(&storage->lock);
-    // get a file request struct
-    // note that since the lock may be released here, the request node fetch
-    // must be performed before node is found or added to manager to avoid
-    // race conditions when it is relocked.
-    if(storage->requestpool != NULL)
+    node = taa_asset_storage_find(storage, group);
+    if(node != NULL)
+    {
+        taa_asset_storage_node** ref = &storage->nodes;
+        while(*ref != node)
+        {
+            ref = &(*ref)->next;
+        }
+        queued = node->requests;
+        ovfnode = taa_asset_storage_unlink(storage, ref);
+    }
+    taa_SPINLOCK_UNLOCK(&storage->lock);
+    if(ovfnode != NULL)
+    {
+        // free overflow node after lock is released
+        free(ovfnode);
+    }
+    while(queued != NULL)
+    {
+        taa_asset_file_request* next = queued->next;
+        // a request submitted after the group was marked may still be
+        // queued, in which case it is cancelled without notification
+        taa_asset_storage_transition(
+            queued,
+            taa_ASSET_REQUEST_QUEUED,
+            taa_ASSET_REQUEST_CANCELLED);
+        taa_asset_storage_discard(queued);
+        queued = next;
+    }
+}
+
+//****************************************************************************
+void taa_asset_complete_request(
+    taa_asset_file_request* req,
+    const void* data,
+    size_t size,
+    taa_asset_release_func releasefunc,
+    void* releasedata)
+{
+    req->data = data;
+    req->size = size;
+    req->releasefunc = releasefunc;
+    req->releasedata = releasedata;
+    if(!taa_asset_storage_transition(
+        req,
+        taa_ASSET_REQUEST_LOADING,
+        taa_ASSET_REQUEST_LOADED))
     {
-        req = storage->requestpool;
-        storage->requestpool = req->next;
+        // the request was cancelled while it was loading. hand the data back
+        // without waiting for the parse stage.
+        if(releasefunc != NULL)
+        {
+            releasefunc(releasedata);
+        }
+        req->releasefunc = NULL;
+        taa_asset_storage_discard(req);
     }
     else
     {
-        // unlock before calling system functions to avoid stalls.
+        taa_asset_storage_deliver(req);
+    }
+}
+
+//****************************************************************************
+taa_asset_file_request* taa_asset_refill_requests(
+    taa_asset_storage* storage,
+    taa_asset_group* group)
+{
+    taa_asset_file_request* submitted;
+    taa_asset_file_request* discard = NULL;
+    taa_asset_file_request* batch = NULL;
+    taa_asset_storage_node* node;
+    taa_asset_storage_node* ovfnode = NULL;
+    uint32_t now;
+    int pending;
+    // pick up new submissions so that urgent work for other groups is seen
+    submitted = taa_asset_storage_drain(storage);
+    now = taa_asset_storage_now(storage);
+    taa_SPINLOCK_LOCK(&storage->lock);
+    taa_asset_storage_gather(storage, submitted, &discard);
+    node = taa_asset_storage_find(storage, group);
+    if(node != NULL)
+    {
+        // the same rule that keeps a worker with its previous group: give
+        // out more requests unless another group is both due and more urgent
+        taa_asset_storage_node** ref = NULL;
+        taa_asset_storage_node** itr = &storage->nodes;
+        int preempted = 0;
+        while(*itr != NULL)
+        {
+            taa_asset_storage_node* other = *itr;
+            if(other == node)
+            {
+                ref = itr;
+            }
+            else if(!taa_asset_storage_before(now, other->deadline) &&
+                    taa_asset_storage_before(other->deadline,node->deadline))
+            {
+                preempted = 1;
+            }
+            itr = &other->next;
+        }
+        if(!preempted)
+        {
+            batch = taa_asset_storage_cut(
+                storage,
+                ref,
+                now,
+                &discard,
+                &ovfnode);
+        }
+    }
+    pending = storage->nodes != NULL;
+    taa_SPINLOCK_UNLOCK(&storage->lock);
+    if(ovfnode != NULL)
+    {
+        // free overflow node after lock is released
+        free(ovfnode);
+        taa_LOG_DEBUG("asset storage freed overflow node req");
+    }
+    while(discard != NULL)
+    {
+        taa_asset_file_request* next = discard->next;
+        taa_asset_storage_discard(discard);
+        discard = next;
+    }
+    if(pending)
+    {
+        // more work remains, so let another thread help with it
+        taa_asset_storage_wake(storage);
+    }
+    return batch;
+}
+
+//****************************************************************************
+int taa_asset_is_request_cancelled(
+    const taa_asset_file_request* req)
+{
+    int32_t status = taa_ASSET_REQUEST_STATUS(req->state);
+    return status == taa_ASSET_REQUEST_CANCELLED ||
+           status == taa_ASSET_REQUEST_ABANDONED;
+}
+
+//****************************************************************************
+void taa_asset_create_completion_queue(
+    uint32_t capacity,
+    taa_asset_completion_queue** cq_out)
+{
+    uintptr_t offset = 0;
+    taa_asset_completion_queue* cq;
+    taa_asset_completion* records;
+    uint32_t size = 1;
+    // round the ring size up to a power of two
+    while(size < capacity)
+    {
+        size <<= 1;
+    }
+    // determine buffer size and pointer offsets
+    cq = (taa_asset_completion_queue*) offset;
+    offset = (uintptr_t) (cq + 1);
+    records = (taa_asset_completion*) taa_ALIGN_PTR(offset, 8);
+    offset = (uintptr_t) (records + size);
+    // allocate the buffer and adjust pointers
+    offset = (uintptr_t) calloc(1, offset);
+    cq = (taa_asset_completion_queue*) (((uintptr_t) cq) + offset);
+    records = (taa_asset_completion*) (((uintptr_t) records) + offset);
+    // initialize struct
+    cq->mask = size - 1;
+    cq->records = records;
+    // set out parameter
+    *cq_out = cq;
+}
+
+//****************************************************************************
+void taa_asset_destroy_completion_queue(
+    taa_asset_completion_queue* cq)
+{
+    free(cq);
+}
+
+//****************************************************************************
+uint32_t taa_asset_drain_completions(
+    taa_asset_completion_queue* cq,
+    taa_asset_completion* records_out,
+    uint32_t maxrecords)
+{
+    uint32_t count = 0;
+    while(count < maxrecords)
+    {
+        taa_asset_completion* rec = records_out + count;
+        taa_asset_completion* recend = rec;
+        taa_asset_completion* recmax = records_out + maxrecords;
+        // copy out as many records as will fit under a single lock
+        taa_SPINLOCK_LOCK(&cq->lock);
+        while(recend != recmax && cq->head != cq->tail)
+        {
+            *recend = cq->records[cq->head & cq->mask];
+            ++cq->head;
+            ++recend;
+        }
+        while(recend != recmax && cq->overflow != NULL)
+        {
+            taa_asset_file_request* req = cq->overflow;
+            cq->overflow = req->next;
+            taa_asset_storage_fill_completion(req, recend);
+            ++recend;
+        }
+        if(cq->overflow == NULL)
+        {
+            cq->overflowtail = NULL;
+        }
+        taa_SPINLOCK_UNLOCK(&cq->lock);
+        if(rec == recend)
+        {
+            // the queue is empty
+            break;
+        }
+        // requests may have been cancelled after they were queued. those
+        // cancelled individually are dropped, those cancelled with their
+        // group are reported without data.
+        while(rec != recend)
+        {
+            taa_asset_file_request* req = rec->request;
+            if(taa_asset_storage_transition(
+                req,
+                taa_ASSET_REQUEST_LOADED,
+                taa_ASSET_REQUEST_PARSING))
+            {
+                records_out[count] = *rec;
+                ++count;
+            }
+            else
+            {
+                int32_t status = taa_ASSET_REQUEST_STATUS(req->state);
+                if(req->releasefunc != NULL)
+                {
+                    req->releasefunc(req->releasedata);
+                    req->releasefunc = NULL;
+                }
+                if(status == taa_ASSET_REQUEST_ABANDONED)
+                {
+                    records_out[count] = *rec;
+                    records_out[count].data = NULL;
+                    records_out[count].size = 0;
+                    records_out[count].status=taa_ASSET_COMPLETION_CANCELLED;
+                    ++count;
+                }
+                else
+                {
+                    taa_asset_storage_recycle(req);
+                }
+            }
+            ++rec;
+        }
+    }
+    return count;
+}
+
+//****************************************************************************
+void taa_asset_release_completion(
+    const taa_asset_completion* record)
+{
+    taa_asset_file_request* req = record->request;
+    if(req->releasefunc != NULL)
+    {
+        // instruct the storage plugin that the data may be reused
+        req->releasefunc(req->releasedata);
+    }
+    taa_asset_storage_recycle(req);
+}
+
+//****************************************************************************
+int taa_asset_raise_request_priority(
+    taa_asset_storage* storage,
+    taa_asset_request_handle handle,
+    taa_asset_priority priority)
+{
+    taa_asset_file_request* req = handle.request;
+    int result = 0;
+    priority = taa_asset_storage_priority(priority);
+    if(req != NULL)
+    {
+        // the deadline may only change while the request is queued, and
+        // the storage threads only dispatch requests while holding the lock
+        taa_SPINLOCK_LOCK(&storage->lock);
+        if(req->state == taa_ASSET_REQUEST_STATE(
+            handle.serial,
+            taa_ASSET_REQUEST_QUEUED))
+        {
+            if(priority < req->priority)
+            {
+                // the deadline is measured from the original submission, so
+                // a request that has already waited may become due at once
+                uint32_t budget = taa_asset_storage_budgets[priority];
+                uint32_t deadline = req->submitted + budget;
+                req->priority = priority;
+                if(taa_asset_storage_before(deadline, req->deadline))
+                {
+                    // if the request is still in the submission stack, the
+                    // node will be updated when it is gathered
+                    taa_asset_storage_node* node;
+                    node = taa_asset_storage_find(storage, req->group);
+                    req->deadline = deadline;
+                    if(node != NULL)
+                    {
+                        node->unsorted = 1;
+                        if(taa_asset_storage_before(deadline,node->deadline))
+                        {
+                            node->deadline = deadline;
+                        }
+                    }
+                }
+            }
+            result = 1;
+        }
         taa_SPINLOCK_UNLOCK(&storage->lock);
+    }
+    return result;
+}
+
+//****************************************************************************
+taa_asset_request_handle taa_asset_request_file(
+    taa_asset_storage* storage,
+    taa_asset_group* group,
+    taa_asset_file* file,
+    taa_workqueue* wq,
+    taa_asset_parse_func parsefunc,
+    void* userdata,
+    taa_asset_priority priority)
+{
+    return taa_asset_request_file_range(
+        storage,
+        group,
+        file,
+        0,
+        0,
+        wq,
+        parsefunc,
+        userdata,
+        priority);
+}
+
+//****************************************************************************
+taa_asset_request_handle taa_asset_request_file_range(
+    taa_asset_storage* storage,
+    taa_asset_group* group,
+    taa_asset_file* file,
+    uint32_t offset,
+    uint32_t length,
+    taa_workqueue* wq,
+    taa_asset_parse_func parsefunc,
+    void* userdata,
+    taa_asset_priority priority)
+{
+    taa_asset_file_request_desc desc;
+    taa_asset_request_handle handle;
+    desc.group = group;
+    desc.file = file;
+    desc.offset = offset;
+    desc.length = length;
+    desc.completionqueue = NULL;
+    desc.workqueue = wq;
+    desc.parsefunc = parsefunc;
+    desc.userdata = userdata;
+    desc.priority = priority;
+    taa_asset_request_files(storage, &desc, 1, &handle);
+    return handle;
+}
+
+//****************************************************************************
+void taa_asset_request_files(
+    taa_asset_storage* storage,
+    const taa_asset_file_request_desc* reqs,
+    uint32_t n,
+    taa_asset_request_handle* handles_out)
+{
+    const taa_asset_file_request_desc* desc = reqs;
+    const taa_asset_file_request_desc* descend = reqs + n;
+    taa_asset_file_request* list;
+    taa_asset_file_request** ref;
+    taa_asset_file_request* req;
+    uint32_t count;
+    uint32_t serial;
+    uint32_t now;
+    if(n == 0)
+    {
+        return;
+    }
+    // reserve all the request structs at once
+    count = taa_asset_storage_pop_pool(storage, n, &list);
+    ref = &list;
+    while(*ref != NULL)
+    {
+        ref = &(*ref)->next;
+    }
+    if(count < n)
+    {
+        // take the remainder from the overflow pool
+        taa_SPINLOCK_LOCK(&storage->overflowlock);
+        while(count < n && storage->overflowpool != NULL)
+        {
+            req = storage->overflowpool;
+            storage->overflowpool = req->next;
+            *ref = req;
+            ref = &req->next;
+            ++count;
+        }
+        taa_SPINLOCK_UNLOCK(&storage->overflowlock);
+        *ref = NULL;
+    }
+    if(count < n)
+    {
+        // everything is in use; allocate what is still needed
+        taa_asset_storage_overflow* ovfhead = NULL;
+        taa_asset_storage_overflow* ovftail = NULL;
         taa_LOG_WARN("asset storage file pool empty, alloced overflow");
-        req = (taa_asset_file_request*) malloc(sizeof(*req));
-        taa_SPINLOCK_LOCK(&storage->lock);
-        // not holding pointers to data that may have changed, so safe
-        // to proceed
+        while(count < n)
+        {
+            taa_asset_storage_overflow* ovf;
+            ovf = (taa_asset_storage_overflow*) malloc(sizeof(*ovf));
+            // the list is walked by taa_asset_cancel_group as soon as it is
+            // published, so the request must look unused until initialized
+            ovf->request.storage = storage;
+            ovf->request.group = NULL;
+            ovf->request.state = taa_ASSET_REQUEST_STATE(
+                0,
+                taa_ASSET_REQUEST_FREE);
+            ovf->next = ovfhead;
+            ovfhead = ovf;
+            ovftail = (ovftail != NULL) ? ovftail : ovf;
+            *ref = &ovf->request;
+            ref = &ovf->request.next;
+            ++count;
+        }
+        *ref = NULL;
+        taa_SPINLOCK_LOCK(&storage->overflowlock);
+        ovftail->next = storage->overflow;
+        storage->overflow = ovfhead;
+        taa_SPINLOCK_UNLOCK(&storage->overflowlock);
     }
-    // try to find an active request node for the specified storage instance
-    node = storage->nodes;
-    itr = node;
-    while(itr != NULL)
+    // serial numbers identify a particular use of the request struct.
+    // reserve a consecutive range for the whole batch.
+    serial = (uint32_t) storage->serial;
+    while(1)
     {
-        if(itr->group == group)
+        uint32_t prev = (uint32_t) taa_ATOMIC_CMPXCHG_32(
+            &storage->serial,
+            (int32_t) (serial + n),
+            (int32_t) serial);
+        if(prev == serial)
         {
-            // found it!
-            node = itr;
             break;
         }
-        itr = itr->next;
+        serial = prev;
     }
-    if(node == NULL)
+    now = taa_asset_storage_now(storage);
+    req = list;
+    while(desc != descend)
     {
-        // no pending requests for the storage instance, need to create one
-        if(storage->pool != NULL)
+        uint32_t filesize = desc->file->size;
+        uint32_t offset = desc->offset;
+        taa_asset_priority priority;
+        ++serial;
+        serial &= 0x0fffffff;
+        // clamp the range to the file so that storage plugins do not need
+        // to check it
+        offset = (offset < filesize) ? offset : filesize;
+        req->file = desc->file;
+        req->handle = desc->file->handle;
+        req->offset = offset;
+        req->length = filesize - offset;
+        if(desc->length != 0 && desc->length < req->length)
         {
-            node = storage->pool;
-            storage->pool = node->next;
+            req->length = desc->length;
         }
-        else
+        req->group = desc->group;
+        req->completionqueue = desc->completionqueue;
+        req->workqueue = desc->workqueue;
+        req->parsefunc = desc->parsefunc;
+        req->userdata = desc->userdata;
+        priority = taa_asset_storage_priority(desc->priority);
+        req->priority = priority;
+        req->cancelfunc = NULL;
+        req->data = NULL;
+        req->size = 0;
+        req->releasefunc = NULL;
+        req->releasedata = NULL;
+        req->submitted = now;
+        req->deadline = now + taa_asset_storage_budgets[priority];
+        req->state = taa_ASSET_REQUEST_STATE(serial,taa_ASSET_REQUEST_QUEUED);
+        if(handles_out != NULL)
         {
-            // unlock before calling system functions to avoid stalls.
-            taa_SPINLOCK_UNLOCK(&storage->lock);
-            taa_LOG_WARN("asset storage node pool empty, alloced overflow");
-            node = (taa_asset_storage_node*) malloc(sizeof(*node));
-            taa_SPINLOCK_LOCK(&storage->lock);
-            // not holding pointers to data that may have changed,
-            // so safe to proceed
-        }
-        node->group = group;
-        node->requests = NULL;
-        node->next = storage->nodes;
-        storage->nodes = node;
-    }
-    req->file = file;
-    req->workqueue = wq;
-    req->parsefunc = parsefunc;
-    req->userdata = userdata;
-    req->next = node->requests;
-    node->requests = req;
-    taa_SPINLOCK_UNLOCK(&storage->lock);
-    taa_semaphore_post(&storage->sem);
+            handles_out->request = req;
+            handles_out->serial = serial;
+            ++handles_out;
+        }
+        ++desc;
+        if(desc != descend)
+        {
+            req = req->next;
+        }
+    }
+    // publish the whole chain and wake a storage thread once
+    taa_asset_storage_submit(storage, list, req);
 }
 
 //****************************************************************************
 void taa_asset_stop_storage_thread(
     taa_asset_storage* storage)
 {
+    taa_asset_storage_worker* worker = storage->workers;
+    taa_asset_storage_worker* workerend = worker + storage->numworkers;
     storage->quit = 1;
-    taa_semaphore_post(&storage->sem);
-    taa_thread_join(storage->thread);
+    // wake every thread so that each one may observe the quit flag
+    while(worker != workerend)
+    {
+        taa_semaphore_post(&storage->sem);
+        ++worker;
+    }
+    worker = storage->workers;
+    while(worker != workerend)
+    {
+        taa_thread_join(worker->thread);
+        ++worker;
+    }
 }
@@ -0,0 +1,742 @@
+#include <taa/assetdir.h>
+#include <taa/assetlz.h>
+#include <taa/assetmap.h>
+#include <taa/assetpack.h>
+#include <taa/hash.h>
+#include <taa/path.h>
+#include <taa/timer.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { SCAN_NUM_FILES = 20000 };
+enum { SCAN_NUM_PASSES = 10 };
+enum { LZ_MAX_SAMPLE_SIZE = 64 << 20 };
+enum { LZ_SYNTH_SIZE = 16 << 20 };
+enum { LZ_NUM_PASSES = 10 };
+enum { MAP_NUM_LOOKUPS = 1 << 22 };
+enum { MAP_BATCH_SIZE = 1000 };
+enum { KEYS_NUM_NAMES = 100000 };
+enum { KEYS_NUM_PASSES = 20 };
+
+typedef struct bench_literal_key_s bench_literal_key;
+
+struct bench_literal_key_s
+{
+    const char* group;
+    const char* path;
+    const char* ext;
+    taa_asset_key key;
+    uint32_t typekey;
+};
+
+//****************************************************************************
+// returns the number of seconds represented by a timer delta
+static double bench_seconds(
+    int64_t delta)
+{
+    return taa_TIMER_NS_TO_MS(delta) / 1000.0;
+}
+
+//****************************************************************************
+// creates the directory of small files used by the scan benchmark, unless
+// it already exists from a previous run
+static void bench_populate_scan_dir(
+    const char* path)
+{
+    taa_asset_dir_storage* dirmgr;
+    taa_asset_group* group;
+    uint32_t numfiles = 0;
+    taa_asset_create_dir_storage(
+        1 << 20,
+        taa_ASSETDIR_DEFAULT_MAX_FDS,
+        0,
+        &dirmgr);
+    group = taa_asset_scan_dir(dirmgr, "scan", path);
+    if(group != NULL)
+    {
+        numfiles = group->numfiles;
+    }
+    taa_asset_destroy_dir_storage(dirmgr);
+    if(numfiles < SCAN_NUM_FILES)
+    {
+        uint32_t i;
+        printf("creating %u files in %s\n", SCAN_NUM_FILES, path);
+        for(i = 0; i < SCAN_NUM_FILES; ++i)
+        {
+            char fname[32];
+            char fpath[taa_PATH_SIZE];
+            FILE* fp;
+            sprintf(fname, "file%05u.dat", i);
+            taa_path_set(fpath, sizeof(fpath), path);
+            taa_path_append(fpath, sizeof(fpath), fname);
+            fp = fopen(fpath, "wb");
+            if(fp != NULL)
+            {
+                fwrite(fname, 1, strlen(fname), fp);
+                fclose(fp);
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// measures the rate at which taa_asset_scan_dir builds a group
+static void bench_scan(
+    const char* rootdir)
+{
+    char path[taa_PATH_SIZE];
+    uint64_t numfiles = 0;
+    int64_t elapsed = 0;
+    int i;
+    taa_path_set(path, sizeof(path), rootdir);
+    taa_path_append(path, sizeof(path), "benchscan");
+    bench_populate_scan_dir(path);
+    for(i = 0; i < SCAN_NUM_PASSES; ++i)
+    {
+        taa_asset_dir_storage* dirmgr;
+        taa_asset_group* group;
+        int64_t start;
+        taa_asset_create_dir_storage(
+            1 << 20,
+            taa_ASSETDIR_DEFAULT_MAX_FDS,
+            0,
+            &dirmgr);
+        start = taa_timer_sample_cpu();
+        group = taa_asset_scan_dir(dirmgr, "scan", path);
+        elapsed += taa_timer_sample_cpu() - start;
+        if(group != NULL)
+        {
+            numfiles += group->numfiles;
+        }
+        taa_asset_destroy_dir_storage(dirmgr);
+    }
+    printf(
+        "scan: %llu files in %.3f s, %.0f files/s\n",
+        (unsigned long long) numfiles,
+        bench_seconds(elapsed),
+        numfiles / bench_seconds(elapsed));
+}
+
+//****************************************************************************
+static void bench_manifest(
+    const char* rootdir)
+{
+    char path[taa_PATH_SIZE];
+    char manifestpath[taa_PATH_SIZE];
+    uint64_t numfiles = 0;
+    int64_t elapsed = 0;
+    int i;
+    taa_path_set(path, sizeof(path), rootdir);
+    taa_path_append(path, sizeof(path), "benchscan");
+    taa_path_set(manifestpath, sizeof(manifestpath), rootdir);
+    taa_path_append(manifestpath, sizeof(manifestpath), "benchscan.manifest");
+    bench_populate_scan_dir(path);
+    remove(manifestpath);
+    // the first pass scans the directory and writes the manifest
+    for(i = -1; i < SCAN_NUM_PASSES; ++i)
+    {
+        taa_asset_dir_storage* dirmgr;
+        taa_asset_group* group;
+        int64_t start;
+        taa_asset_create_dir_storage(
+            1 << 20,
+            taa_ASSETDIR_DEFAULT_MAX_FDS,
+            0,
+            &dirmgr);
+        start = taa_timer_sample_cpu();
+        group = taa_asset_scan_dir_manifest(dirmgr,"scan",path,manifestpath);
+        if(i >= 0)
+        {
+            elapsed += taa_timer_sample_cpu() - start;
+            if(group != NULL)
+            {
+                numfiles += group->numfiles;
+            }
+        }
+        taa_asset_destroy_dir_storage(dirmgr);
+    }
+    printf(
+        "manifest: %llu files in %.3f s, %.0f files/s\n",
+        (unsigned long long) numfiles,
+        bench_seconds(elapsed),
+        numfiles / bench_seconds(elapsed));
+}
+
+//****************************************************************************
+// loads the images written by tgatest into one buffer as a sample of real
+// content. if there are none, images of flat tiles are synthesized, with
+// noise added to every fourth tile.
+static unsigned char* bench_load_lz_sample(
+    const char* rootdir,
+    uint32_t* size_out)
+{
+    char path[taa_PATH_SIZE];
+    taa_asset_dir_storage* dirmgr;
+    taa_asset_group* group;
+    unsigned char* sample = (unsigned char*) malloc(LZ_MAX_SAMPLE_SIZE);
+    uint32_t size = 0;
+    uint32_t i;
+    taa_path_set(path, sizeof(path), rootdir);
+    taa_path_append(path, sizeof(path), "data");
+    taa_asset_create_dir_storage(
+        1 << 20,
+        taa_ASSETDIR_DEFAULT_MAX_FDS,
+        0,
+        &dirmgr);
+    group = taa_asset_scan_dir(dirmgr, "data", path);
+    for(i = 0; group != NULL && i < group->numfiles; ++i)
+    {
+        const taa_asset_file* file = group->files + i;
+        if(strstr(file->name, ".tga") != NULL &&
+           file->size <= LZ_MAX_SAMPLE_SIZE - size)
+        {
+            FILE* fp = fopen((const char*) file->handle, "rb");
+            if(fp != NULL)
+            {
+                size += fread(sample + size, 1, file->size, fp);
+                fclose(fp);
+            }
+        }
+    }
+    taa_asset_destroy_dir_storage(dirmgr);
+    if(size == 0)
+    {
+        printf("no images in %s, using synthetic data\n", path);
+        srand(1);
+        for(i = 0; i < LZ_SYNTH_SIZE; i += 4)
+        {
+            uint32_t x = (i / 4) & 1023;
+            uint32_t y = ((i / 4) >> 10) & 1023;
+            uint32_t noise = 0;
+            if(((x / 64 + y / 64) & 3) == 0)
+            {
+                noise = rand() & 15;
+            }
+            sample[i + 0] = (unsigned char) ((x / 64) * 16 + noise);
+            sample[i + 1] = (unsigned char) ((y / 64) * 16 + noise);
+            sample[i + 2] = (unsigned char) (((x ^ y) / 128) * 32);
+            sample[i + 3] = 0xff;
+        }
+        size = LZ_SYNTH_SIZE;
+    }
+    *size_out = size;
+    return sample;
+}
+
+//****************************************************************************
+// measures the compression ratio of pack blocks and the throughput of a
+// single thread compressing and decompressing them
+static void bench_lz(
+    const char* rootdir)
+{
+    uint32_t blocksize = taa_ASSETPACK_DEFAULT_BLOCK_SIZE;
+    uint32_t size;
+    unsigned char* sample = bench_load_lz_sample(rootdir, &size);
+    uint32_t numblocks = (size + blocksize - 1) / blocksize;
+    uint32_t bound = taa_asset_lz_bound(blocksize);
+    unsigned char* compressed = (unsigned char*) malloc(numblocks * bound);
+    uint32_t* sizes = (uint32_t*) malloc(numblocks * sizeof(*sizes));
+    unsigned char* decompressed = (unsigned char*) malloc(size);
+    uint64_t total = 0;
+    int64_t ctime = 0;
+    int64_t dtime = 0;
+    int ok = 1;
+    int pass;
+    uint32_t i;
+    for(pass = 0; pass < LZ_NUM_PASSES; ++pass)
+    {
+        int64_t start = taa_timer_sample_cpu();
+        total = 0;
+        for(i = 0; i < numblocks; ++i)
+        {
+            uint32_t n = size - i*blocksize;
+            n = (n < blocksize) ? n : blocksize;
+            sizes[i] = taa_asset_lz_compress(
+                sample + i*blocksize,
+                n,
+                compressed + i*bound,
+                bound);
+            total += sizes[i];
+        }
+        ctime += taa_timer_sample_cpu() - start;
+        start = taa_timer_sample_cpu();
+        for(i = 0; i < numblocks; ++i)
+        {
+            uint32_t n = size - i*blocksize;
+            n = (n < blocksize) ? n : blocksize;
+            ok &= taa_asset_lz_decompress(
+                compressed + i*bound,
+                sizes[i],
+                decompressed + i*blocksize,
+                n);
+        }
+        dtime += taa_timer_sample_cpu() - start;
+    }
+    ok &= !memcmp(sample, decompressed, size);
+    printf(
+        "lz: %u bytes in %u blocks, ratio %.3f, "
+        "compress %.1f MB/s, decompress %.1f MB/s%s\n",
+        size,
+        numblocks,
+        ((double) total) / size,
+        (((double) size) * LZ_NUM_PASSES) / (1 << 20) / bench_seconds(ctime),
+        (((double) size) * LZ_NUM_PASSES) / (1 << 20) / bench_seconds(dtime),
+        ok ? "" : " (MISMATCH)");
+    free(decompressed);
+    free(sizes);
+    free(compressed);
+    free(sample);
+}
+
+//****************************************************************************
+// orders keys the same way as the map
+static int bench_compare_keys(
+    const void* a,
+    const void* b)
+{
+    const taa_asset_key* ka = (const taa_asset_key*) a;
+    const taa_asset_key* kb = (const taa_asset_key*) b;
+    int result = 0;
+    if(ka->parts.group != kb->parts.group)
+    {
+        result = (ka->parts.group < kb->parts.group) ? -1 : 1;
+    }
+    else if(ka->parts.file != kb->parts.file)
+    {
+        result = (ka->parts.file < kb->parts.file) ? -1 : 1;
+    }
+    return result;
+}
+
+//****************************************************************************
+// the binary search over sorted keys that the map used before it had a hash
+// index, which serves as the baseline
+static uint32_t bench_search_sorted(
+    const taa_asset_key* keys,
+    uint32_t numkeys,
+    taa_asset_key key)
+{
+    uint32_t lo = 0;
+    uint32_t hi = numkeys;
+    while(lo < hi)
+    {
+        uint32_t i = lo + ((hi-lo) >> 1);
+        const taa_asset_key* k = keys + i;
+        if(k->parts.group < key.parts.group)
+        {
+            lo = i + 1;
+        }
+        else if(k->parts.group == key.parts.group &&
+                k->parts.file < key.parts.file)
+        {
+            lo = i + 1;
+        }
+        else
+        {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+//****************************************************************************
+// the branchless search the map uses to find the sorted position of a key,
+// over keys stored as 64 bit values with the group key in the upper half
+static uint32_t bench_search_branchless(
+    const uint64_t* keys,
+    uint32_t numkeys,
+    uint64_t key)
+{
+    const uint64_t* base = keys;
+    uint32_t n = numkeys;
+    while(n > 1)
+    {
+        uint32_t half = n >> 1;
+#if defined(__GNUC__)
+        __builtin_prefetch(base + (half >> 1));
+        __builtin_prefetch(base + half + (half >> 1));
+#endif
+        base = (base[half] < key) ? base + half : base;
+        n -= half;
+    }
+    return (uint32_t) (base - keys) + (*base < key);
+}
+
+//****************************************************************************
+// measures the time to register a group of files with the map, and the time
+// to find keys in random order with taa_asset_find and with binary searches
+// of the same keys in a sorted array. the keys are then also found in
+// batches, both one at a time and with taa_asset_find_many.
+static void bench_map()
+{
+    static const uint32_t counts[] = { 10000, 100000, 1000000 };
+    taa_asset_key* lookups;
+    taa_asset_map_value** values;
+    uint32_t c;
+    lookups = (taa_asset_key*) malloc(MAP_NUM_LOOKUPS * sizeof(*lookups));
+    values = (taa_asset_map_value**) malloc(MAP_BATCH_SIZE*sizeof(*values));
+    for(c = 0; c < sizeof(counts)/sizeof(*counts); ++c)
+    {
+        uint32_t n = counts[c];
+        taa_asset_group group;
+        taa_asset_file* files;
+        taa_asset_key* keys;
+        uint64_t* orderkeys;
+        taa_asset_map* map;
+        uint32_t seed = 1;
+        uint32_t sortedfound = 0;
+        uint32_t branchlessfound = 0;
+        uint32_t hashfound = 0;
+        uint32_t loopfound = 0;
+        uint32_t batchfound = 0;
+        uint32_t numbatched = 0;
+        int64_t registertime;
+        int64_t sortedtime;
+        int64_t branchlesstime;
+        int64_t hashtime;
+        int64_t looptime;
+        int64_t batchtime;
+        int64_t start;
+        uint32_t i;
+        files = (taa_asset_file*) calloc(n, sizeof(*files));
+        keys = (taa_asset_key*) malloc(n * sizeof(*keys));
+        orderkeys = (uint64_t*) malloc(n * sizeof(*orderkeys));
+        memset(&group, 0, sizeof(group));
+        group.name = "map";
+        group.key = taa_asset_gen_groupkey(group.name);
+        group.numfiles = n;
+        group.files = files;
+        // multiplying by an odd constant gives unique keys in scrambled
+        // order, like the hashed names of a real group
+        for(i = 0; i < n; ++i)
+        {
+            files[i].filekey = (i + 1) * 2654435761U;
+            keys[i].parts.group = group.key;
+            keys[i].parts.file = files[i].filekey;
+        }
+        taa_asset_create_map(n, &map);
+        start = taa_timer_sample_cpu();
+        taa_asset_register_group(map, &group, 0);
+        registertime = taa_timer_sample_cpu() - start;
+        qsort(keys, n, sizeof(*keys), bench_compare_keys);
+        for(i = 0; i < n; ++i)
+        {
+            orderkeys[i] = (((uint64_t) keys[i].parts.group) << 32) |
+                keys[i].parts.file;
+        }
+        for(i = 0; i < MAP_NUM_LOOKUPS; ++i)
+        {
+            seed = seed * 1664525 + 1013904223;
+            lookups[i] = keys[(uint32_t) (((uint64_t) seed * n) >> 32)];
+        }
+        start = taa_timer_sample_cpu();
+        for(i = 0; i < MAP_NUM_LOOKUPS; ++i)
+        {
+            uint32_t j = bench_search_sorted(keys, n, lookups[i]);
+            sortedfound += (j < n && keys[j].all == lookups[i].all);
+        }
+        sortedtime = taa_timer_sample_cpu() - start;
+        start = taa_timer_sample_cpu();
+        for(i = 0; i < MAP_NUM_LOOKUPS; ++i)
+        {
+            taa_asset_key k = lookups[i];
+            uint64_t key = (((uint64_t) k.parts.group) << 32) | k.parts.file;
+            uint32_t j = bench_search_branchless(orderkeys, n, key);
+            branchlessfound += (j < n && orderkeys[j] == key);
+        }
+        branchlesstime = taa_timer_sample_cpu() - start;
+        start = taa_timer_sample_cpu();
+        for(i = 0; i < MAP_NUM_LOOKUPS; ++i)
+        {
+            hashfound += (taa_asset_find(map, lookups[i]) != NULL);
+        }
+        hashtime = taa_timer_sample_cpu() - start;
+        printf(
+            "map: %7u keys, register %.1f ms, sorted %.1f ns, "
+            "branchless %.1f ns, hashed %.1f ns per lookup%s\n",
+            n,
+            bench_seconds(registertime) * 1e3,
+            bench_seconds(sortedtime) * 1e9 / MAP_NUM_LOOKUPS,
+            bench_seconds(branchlesstime) * 1e9 / MAP_NUM_LOOKUPS,
+            bench_seconds(hashtime) * 1e9 / MAP_NUM_LOOKUPS,
+            (sortedfound == MAP_NUM_LOOKUPS &&
+             branchlessfound == MAP_NUM_LOOKUPS &&
+             hashfound == MAP_NUM_LOOKUPS) ? "" : " (MISMATCH)");
+        // resolve the same keys in batches, once with a loop over
+        // taa_asset_find and once with taa_asset_find_many
+        start = taa_timer_sample_cpu();
+        for(i = 0; i + MAP_BATCH_SIZE <= MAP_NUM_LOOKUPS; i+=MAP_BATCH_SIZE)
+        {
+            uint32_t j;
+            for(j = 0; j < MAP_BATCH_SIZE; ++j)
+            {
+                values[j] = taa_asset_find(map, lookups[i + j]);
+            }
+            for(j = 0; j < MAP_BATCH_SIZE; ++j)
+            {
+                loopfound += (values[j] != NULL);
+            }
+        }
+        looptime = taa_timer_sample_cpu() - start;
+        start = taa_timer_sample_cpu();
+        for(i = 0; i + MAP_BATCH_SIZE <= MAP_NUM_LOOKUPS; i+=MAP_BATCH_SIZE)
+        {
+            uint32_t j;
+            taa_asset_find_many(map, lookups + i, MAP_BATCH_SIZE, values);
+            for(j = 0; j < MAP_BATCH_SIZE; ++j)
+            {
+                batchfound += (values[j] != NULL);
+            }
+            numbatched += MAP_BATCH_SIZE;
+        }
+        batchtime = taa_timer_sample_cpu() - start;
+        printf(
+            "map: %7u keys, batches of %u, find %.1f ns, "
+            "find_many %.1f ns per key%s\n",
+            n,
+            MAP_BATCH_SIZE,
+            bench_seconds(looptime) * 1e9 / numbatched,
+            bench_seconds(batchtime) * 1e9 / numbatched,
+            (loopfound == numbatched && batchfound == numbatched) ?
+                "" : " (MISMATCH)");
+        taa_asset_destroy_map(map);
+        free(orderkeys);
+        free(keys);
+        free(files);
+    }
+    free(values);
+    free(lookups);
+}
+
+//****************************************************************************
+// the file key generation used before keys were hashed without a copy,
+// which serves as the baseline
+static uint32_t bench_filekey_pjw(
+    const char* name)
+{
+    char fmtname[taa_PATH_SIZE];
+    char* dstitr = fmtname;
+    char* dstend = fmtname + sizeof(fmtname);
+    const char* srcitr;
+    const char* srcend;
+    srcitr = strrchr(name, taa_PATH_SLASH);
+    srcitr = (srcitr != NULL) ? srcitr + 1 : name;
+    srcend = strchr(srcitr, '.');
+    srcend = (srcend != NULL) ? srcend + 1 : srcitr + strlen(srcitr) + 1;
+    while(dstitr != dstend && srcitr != srcend)
+    {
+        *dstitr = tolower(*srcitr);
+        ++dstitr;
+        ++srcitr;
+    }
+    --dstitr;
+    *dstitr = '\0';
+    return taa_hash_pjw(fmtname);
+}
+
+//****************************************************************************
+// orders 32 bit keys for counting duplicates
+static int bench_compare_u32(
+    const void* a,
+    const void* b)
+{
+    uint32_t ka = *((const uint32_t*) a);
+    uint32_t kb = *((const uint32_t*) b);
+    return (ka < kb) ? -1 : ((ka > kb) ? 1 : 0);
+}
+
+//****************************************************************************
+// returns the number of keys that are the same as the key before them once
+// the keys are sorted
+static uint32_t bench_count_duplicates(
+    uint32_t* keys,
+    uint32_t numkeys)
+{
+    uint32_t count = 0;
+    uint32_t i;
+    qsort(keys, numkeys, sizeof(*keys), bench_compare_u32);
+    for(i = 1; i < numkeys; ++i)
+    {
+        count += (keys[i] == keys[i - 1]);
+    }
+    return count;
+}
+
+//****************************************************************************
+// checks the keys given by the compile time macros against the keys
+// generated at run time, and returns the number of keys checked
+static uint32_t bench_check_keys(
+    int* ok_out)
+{
+    static const bench_literal_key literals[] =
+    {
+        {
+            "", "", "",
+            taa_ASSET_KEY_INIT("", ""),
+            taa_ASSET_TYPEKEY("")
+        },
+        {
+            "data", "a", "dat",
+            taa_ASSET_KEY_INIT("data", "a"),
+            taa_ASSET_TYPEKEY("dat")
+        },
+        {
+            "Textures", "textures/Hero.TGA", "TGA",
+            taa_ASSET_KEY_INIT("textures", "hero"),
+            taa_ASSET_TYPEKEY("tga")
+        },
+        {
+            "levels/Forest", "Forest_Floor_01.mesh", "mesh",
+            taa_ASSET_KEY_INIT("levels/forest", "forest_floor_01"),
+            taa_ASSET_TYPEKEY("MESH")
+        },
+        {
+            "sounds", "sounds/ui/Click-Short.wav", "wav",
+            taa_ASSET_KEY_INIT("sounds", "click-short"),
+            taa_ASSET_TYPEKEY("wav")
+        },
+        {
+            "abc\303\204def", "abc\303\204def.bin", "bin",
+            taa_ASSET_KEY_INIT("abc\303\204def", "abc\303\204def"),
+            taa_ASSET_TYPEKEY("bin")
+        },
+        {
+            "0123456789abcdefghijklmnopqrstuvwxyz"
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZ!@",
+            "Hero_Characters_Diffuse_Albedo_"
+                "Roughness_Metal_Normal_Height.tga",
+            "0123456789abcdefghijklmnopqrstuvwxyz"
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZ!@",
+            taa_ASSET_KEY_INIT(
+                "0123456789abcdefghijklmnopqrstuvwxyz"
+                    "abcdefghijklmnopqrstuvwxyz!@",
+                "hero_characters_diffuse_albedo_"
+                    "roughness_metal_normal_height"),
+            taa_ASSET_TYPEKEY(
+                "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                    "abcdefghijklmnopqrstuvwxyz!@")
+        }
+    };
+    uint32_t numliterals = sizeof(literals)/sizeof(*literals);
+    const bench_literal_key* itr = literals;
+    const bench_literal_key* end = literals + numliterals;
+    int ok = 1;
+    while(itr != end)
+    {
+        taa_asset_key key = taa_asset_gen_key(itr->group, itr->path);
+        uint64_t key64 = taa_asset_gen_filekey64(itr->path);
+        ok &= (key.all == itr->key.all);
+        ok &= (taa_asset_gen_groupkey(itr->group) == itr->key.parts.group);
+        ok &= (taa_asset_gen_filekey(itr->path) == itr->key.parts.file);
+        ok &= ((uint32_t) (key64 >> 32) == itr->key.parts.file);
+        ok &= (taa_asset_gen_typekey(itr->ext) == itr->typekey);
+        ++itr;
+    }
+    *ok_out = ok;
+    return numliterals;
+}
+
+//****************************************************************************
+// measures the time to generate file keys from short names and from longer
+// paths, with the baseline and with taa_asset_gen_filekey, and counts the
+// names that were given the same key. a good 32 bit hash gives about one
+// duplicate for this many names.
+static void bench_keys()
+{
+    static const char* formats[] =
+    {
+        "file%s.dat",
+        "textures/characters/Hero_%s_Diffuse_Albedo.tga"
+    };
+    char* names = (char*) malloc(KEYS_NUM_NAMES * 64);
+    uint32_t* keys = (uint32_t*) malloc(KEYS_NUM_NAMES * sizeof(*keys));
+    uint32_t f;
+    int ok;
+    uint32_t numchecked = bench_check_keys(&ok);
+    printf(
+        "keys: %u compile time keys checked%s\n",
+        numchecked,
+        ok ? "" : " (MISMATCH)");
+    for(f = 0; f < sizeof(formats)/sizeof(*formats); ++f)
+    {
+        uint32_t pjwdups;
+        uint32_t dups;
+        int64_t pjwtime = 0;
+        int64_t time = 0;
+        int64_t start;
+        uint32_t pass;
+        uint32_t i;
+        // the names differ in four letters, like names that are made of
+        // words rather than numbers
+        for(i = 0; i < KEYS_NUM_NAMES; ++i)
+        {
+            char code[5];
+            code[0] = (char) ('a' + i % 26);
+            code[1] = (char) ('a' + i/26 % 26);
+            code[2] = (char) ('a' + i/(26*26) % 26);
+            code[3] = (char) ('a' + i/(26*26*26) % 26);
+            code[4] = '\0';
+            sprintf(names + i*64, formats[f], code);
+        }
+        for(pass = 0; pass < KEYS_NUM_PASSES; ++pass)
+        {
+            start = taa_timer_sample_cpu();
+            for(i = 0; i < KEYS_NUM_NAMES; ++i)
+            {
+                keys[i] = bench_filekey_pjw(names + i*64);
+            }
+            pjwtime += taa_timer_sample_cpu() - start;
+        }
+        pjwdups = bench_count_duplicates(keys, KEYS_NUM_NAMES);
+        for(pass = 0; pass < KEYS_NUM_PASSES; ++pass)
+        {
+            start = taa_timer_sample_cpu();
+            for(i = 0; i < KEYS_NUM_NAMES; ++i)
+            {
+                keys[i] = taa_asset_gen_filekey(names + i*64);
+            }
+            time += taa_timer_sample_cpu() - start;
+        }
+        dups = bench_count_duplicates(keys, KEYS_NUM_NAMES);
+        printf(
+            "keys: %s, pjw %.1f ns (%u duplicates), "
+            "gen_filekey %.1f ns (%u duplicates) per key\n",
+            formats[f],
+            bench_seconds(pjwtime) * 1e9 / (KEYS_NUM_NAMES*KEYS_NUM_PASSES),
+            pjwdups,
+            bench_seconds(time) * 1e9 / (KEYS_NUM_NAMES*KEYS_NUM_PASSES),
+            dups);
+    }
+    free(keys);
+    free(names);
+}
+
+int main(int argc, char* argv[])
+{
+    char rootdir[taa_PATH_SIZE];
+    const char* name = (argc > 1) ? argv[1] : NULL;
+    taa_path_get_dir(argv[0], rootdir, sizeof(rootdir));
+    if(name == NULL || !strcmp(name, "scan"))
+    {
+        bench_scan(rootdir);
+    }
+    if(name == NULL || !strcmp(name, "manifest"))
+    {
+        bench_manifest(rootdir);
+    }
+    if(name == NULL || !strcmp(name, "lz"))
+    {
+        bench_lz(rootdir);
+    }
+    if(name == NULL || !strcmp(name, "map"))
+    {
+        bench_map();
+    }
+    if(name == NULL || !strcmp(name, "keys"))
+    {
+        bench_keys();
+    }
+    return EXIT_SUCCESS;
+}
@@ -7,7 +7,9 @@
 #include "../../src/asset.c"
 #include "../../src/assetcache.c"
 #include "../../src/assetdir.c"
+#include "../../src/assetlz.c"
 #include "../../src/assetmap.c"
+#include "../../src/assetpack.c"
 #include "../../src/assetstorage.c"
 
 #include "../../../taasdk/src/conditionvar.c"
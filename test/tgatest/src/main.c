@@ -25,6 +25,8 @@ enum { IMAGE_WIDTH = 512 };
 enum { IMAGE_HEIGHT = 512 };
 enum { NUM_IMAGES = 64 };
 enum { NUM_WORKER_THREADS = 2 };
+enum { NUM_STORAGE_THREADS = 2 };
+enum { DIR_STORAGE_BUDGET = 4 << 20 };
 enum { NUM_BOXES = 8 };
 
 void diamondsquare(
@@ -290,8 +292,12 @@ void main_exec(
     taa_texture2d_create(&txfont);
     debugfont_init(txfont);
     // initialize asset managers. opengl contexts must be active at this point
-    taa_asset_create_storage(2, 8, &storage);
-    taa_asset_create_dir_storage(2, &dirmgr);
+    taa_asset_create_storage(2, 8, NUM_STORAGE_THREADS, &storage);
+    taa_asset_create_dir_storage(
+        DIR_STORAGE_BUDGET,
+        taa_ASSETDIR_DEFAULT_MAX_FDS,
+        taa_ASSETDIR_MMAP,
+        &dirmgr);
     tgaasset_create_mgr(storage,wq,32,12,&tgamgr);
     // create data
     populate_asset_dir(rootdir, "data");
@@ -300,6 +306,8 @@ void main_exec(
     if(group != NULL)
     {
         tgaasset_register_storage(tgamgr, group);
+        // reload images that are edited while running
+        taa_asset_watch_dir(dirmgr, group);
     }
     // ready to begin, show the window
     taa_keyboard_query(mwin->windisplay, &kb);
@@ -364,6 +372,8 @@ void main_exec(
             };
             ++evt;
         }
+        // apply changes to the asset directory
+        taa_asset_update_dir_storage(dirmgr, tgaasset_change_file, tgamgr);
         // sim assets
         for(i = 0; i < NUM_BOXES; ++i)
         {
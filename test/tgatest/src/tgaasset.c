@@ -14,9 +14,14 @@ struct tgaasset_s
     taa_texture2d texture;
     tgaasset_mgr* mgr;
     int32_t cacheentry;
-    taa_asset_map_value* mapval;
+    // the key the asset was loaded for. map values may move when files are
+    // added or removed, so the asset refers to its value by key.
+    taa_asset_key key;
+    taa_asset_request_handle request;
     taa_asset_state state;
     int32_t refcount;
+    // links overflow instances that are not in use
+    tgaasset* next;
 };
 
 struct tgaasset_mgr_s
@@ -27,6 +32,9 @@ struct tgaasset_mgr_s
     taa_asset_cache* cache;
     taa_asset_map* map;
     tgaasset* assets;
+    // overflow instances are kept for reuse instead of being freed, since
+    // acquires that do not take the lock may still be reading them
+    tgaasset* overflow;
     uint32_t cachesize;
 };
 
@@ -101,9 +109,12 @@ static void tgaasset_create(
 {
     asset->mgr = mgr;
     asset->state = taa_ASSET_UNLOADED;
-    asset->mapval = NULL;
+    asset->key.all = 0;
+    asset->request.request = NULL;
+    asset->request.serial = 0;
     asset->cacheentry = -1;
     asset->refcount = 0;
+    asset->next = NULL;
     taa_texture2d_create(&asset->texture);
     taa_texture2d_bind(asset->texture);
     taa_texture2d_setparameter(taa_TEXPARAM_MAX_LEVEL, 0);
@@ -121,7 +132,50 @@ static void tgaasset_destroy(
 }
 
 //****************************************************************************
-tgaasset* tgaasset_acquire(
+// clears the map value of an asset if it still refers to the asset. must be
+// called with the lock held.
+static void tgaasset_detach(
+    tgaasset_mgr* mgr,
+    tgaasset* asset)
+{
+    taa_asset_map_value* mapval = taa_asset_find(mgr->map, asset->key);
+    if(mapval != NULL && mapval->asset == (taa_asset*) asset)
+    {
+        mapval->asset = NULL;
+    }
+}
+
+//****************************************************************************
+// adds a reference to an asset that is loaded and in use without taking the
+// lock. returns zero if the caller must take the lock instead.
+static int tgaasset_try_addref(
+    tgaasset* asset,
+    const taa_asset_key key)
+{
+    int32_t refcount = asset->refcount;
+    int result = 0;
+    // an asset without references may be unpinned and reassigned at any
+    // time, so only one that is already referenced can be shared
+    if(refcount > 0 &&
+       asset->key.all == key.all &&
+       taa_ATOMIC_CMPXCHG_32(&asset->refcount,refcount+1,refcount)==refcount)
+    {
+        // the asset may have been reassigned between the checks. now that
+        // it is referenced it can not change, so check it again.
+        if(asset->key.all == key.all && asset->state == taa_ASSET_LOADED)
+        {
+            result = 1;
+        }
+        else
+        {
+            tgaasset_release(asset);
+        }
+    }
+    return result;
+}
+
+//****************************************************************************
+static tgaasset* tgaasset_acquire_locked(
     tgaasset_mgr* mgr,
     const taa_asset_key key)
 {
@@ -134,7 +188,7 @@ tgaasset* tgaasset_acquire(
         asset = (tgaasset*) mapval->asset;
         // if the map value has a data reference, need to verify that the data
         // still belongs to the map value and hasn't been reassigned.
-        if(asset != NULL && asset->mapval == mapval)
+        if(asset != NULL && asset->key.all == key.all)
         {
             if(asset->refcount == 0)
             {
@@ -151,7 +205,8 @@ tgaasset* tgaasset_acquire(
             }
             if(asset != NULL)
             {
-                ++asset->refcount; // add refcount for fetch
+                // add refcount for fetch
+                taa_ATOMIC_INC_32(&asset->refcount);
             }
             taa_SPINLOCK_UNLOCK(&mgr->lock);
         }
@@ -165,6 +220,12 @@ tgaasset* tgaasset_acquire(
                 asset = (tgaasset*) hasset;
                 asset->cacheentry = hcache;
             }
+            else if(mgr->overflow != NULL)
+            {
+                // cache is full, reuse an overflow instance
+                asset = mgr->overflow;
+                mgr->overflow = asset->next;
+            }
             else
             {
                 // cache is full, overflow instance needs to be created
@@ -174,19 +235,21 @@ tgaasset* tgaasset_acquire(
             }
             mapval->asset = (taa_asset*) asset;
             // the asset needs to be loaded
-            asset->mapval = mapval;
+            asset->key = key;
             asset->state = taa_ASSET_LOADING;
-            ++asset->refcount; // add refcount for fetch
-            ++asset->refcount; // add additionl refcount for load
+            // add refcount for fetch and additional refcount for load
+            taa_ATOMIC_INC_32(&asset->refcount);
+            taa_ATOMIC_INC_32(&asset->refcount);
             // unlock before making request to prevent deadlocks
             taa_SPINLOCK_UNLOCK(&mgr->lock);
-            taa_asset_request_file(
+            asset->request = taa_asset_request_file(
                 mgr->storage,
                 mapval->group,
                 mapval->file,
                 mgr->workqueue,
                 tgaasset_parse,
-                asset);
+                asset,
+                taa_ASSET_PRIORITY_VISIBLE);
         }
     }
     else
@@ -196,6 +259,101 @@ tgaasset* tgaasset_acquire(
     return asset;
 }
 
+//****************************************************************************
+tgaasset* tgaasset_acquire(
+    tgaasset_mgr* mgr,
+    const taa_asset_key key)
+{
+    tgaasset* asset = NULL;
+    taa_asset_map_value* mapval;
+    uint32_t reader;
+    // assets that are loaded and in use are shared without taking the lock,
+    // which is the common case when many jobs acquire the same assets
+    reader = taa_asset_begin_map_read(mgr->map);
+    mapval = taa_asset_find(mgr->map, key);
+    if(mapval != NULL)
+    {
+        asset = (tgaasset*) mapval->asset;
+        if(asset != NULL && !tgaasset_try_addref(asset, key))
+        {
+            asset = NULL;
+        }
+    }
+    taa_asset_end_map_read(mgr->map, reader);
+    if(asset == NULL)
+    {
+        asset = tgaasset_acquire_locked(mgr, key);
+    }
+    return asset;
+}
+
+//****************************************************************************
+void tgaasset_change_file(
+    taa_asset_group* group,
+    taa_asset_file* file,
+    taa_asset_dir_change change,
+    void* userdata)
+{
+    tgaasset_mgr* mgr = (tgaasset_mgr*) userdata;
+    tgaasset* asset = NULL;
+    taa_asset_map_value* mapval = NULL;
+    taa_asset_key key;
+    // only tga files are in the map
+    int istga = (file->typekey == taa_ASSET_TYPEKEY("tga"));
+    key.parts.group = group->key;
+    key.parts.file = file->filekey;
+    taa_SPINLOCK_LOCK(&mgr->lock);
+    if(istga)
+    {
+        mapval = taa_asset_find(mgr->map, key);
+    }
+    if(change == taa_ASSETDIR_FILE_ADDED && istga)
+    {
+        taa_asset_insert(mgr->map, group, file);
+    }
+    else if(change == taa_ASSETDIR_FILE_REMOVED && mapval != NULL)
+    {
+        // assets that are still referenced keep their data until they are
+        // released
+        taa_asset_remove(mgr->map, key);
+    }
+    else if(change == taa_ASSETDIR_FILE_MOVED && mapval != NULL)
+    {
+        mapval->file = file;
+    }
+    else if(change == taa_ASSETDIR_FILE_MODIFIED && mapval != NULL)
+    {
+        asset = (tgaasset*) mapval->asset;
+        if(asset != NULL && asset->key.all == key.all && asset->refcount > 0)
+        {
+            // add refcount for load
+            taa_ATOMIC_INC_32(&asset->refcount);
+        }
+        else
+        {
+            // the asset is not in use, so the next acquire will load the
+            // new data
+            mapval->asset = NULL;
+            asset = NULL;
+        }
+    }
+    // unlock before making request to prevent deadlocks
+    taa_SPINLOCK_UNLOCK(&mgr->lock);
+    if(asset != NULL)
+    {
+        // the texture keeps its old image until the new data is parsed into
+        // it, so the asset is swapped in place for everyone holding it
+        asset->request = taa_asset_request_file(
+            mgr->storage,
+            group,
+            file,
+            mgr->workqueue,
+            tgaasset_parse,
+            asset,
+            taa_ASSET_PRIORITY_VISIBLE);
+    }
+}
+
 //****************************************************************************
 void tgaasset_create_mgr(
     taa_asset_storage* storage,
@@ -227,6 +385,7 @@ void tgaasset_create_mgr(
     taa_asset_create_cache(cachesize, &mgr->cache);
     taa_asset_create_map(totalcapacity, &mgr->map);
     mgr->assets = asset;
+    mgr->overflow = NULL;
     mgr->cachesize = cachesize;
     // initialize asset cache data
     i = 0;
@@ -253,6 +412,14 @@ void tgaasset_destroy_mgr(
         tgaasset_destroy(asset);
         ++asset;
     }
+    // clean up overflow instances
+    while(mgr->overflow != NULL)
+    {
+        asset = mgr->overflow;
+        mgr->overflow = asset->next;
+        tgaasset_destroy(asset);
+        free(asset);
+    }
     // clean up struct members
     taa_asset_destroy_map(mgr->map);
     taa_asset_destroy_cache(mgr->cache);
@@ -283,7 +450,7 @@ void tgaasset_register_storage(
     tgaasset_mgr* mgr,
     taa_asset_group* group)
 {
-    uint32_t typekey = taa_asset_gen_typekey("tga");
+    uint32_t typekey = taa_ASSET_TYPEKEY("tga");
     taa_asset_register_group(mgr->map, group, typekey);
 }
 
@@ -292,10 +459,28 @@ void tgaasset_release(
     tgaasset* asset)
 {
     tgaasset_mgr* mgr = asset->mgr;
+    int32_t refcount;
     assert(asset->refcount != 0);
-    if(taa_ATOMIC_DEC_32(&asset->refcount) == 0)
+    refcount = taa_ATOMIC_DEC_32(&asset->refcount);
+    if(refcount == 1 && asset->state == taa_ASSET_LOADING)
+    {
+        // only the load reference remains, so nobody wants the data. if the
+        // request can be cancelled before it is parsed, release the load
+        // reference on behalf of the parse function.
+        taa_SPINLOCK_LOCK(&mgr->lock);
+        if(asset->refcount == 1 &&
+           taa_asset_cancel_request(mgr->storage, asset->request))
+        {
+            // disassociate the asset from the map so that the next acquire
+            // issues a new request
+            asset->state = taa_ASSET_UNLOADED;
+            tgaasset_detach(mgr, asset);
+            refcount = taa_ATOMIC_DEC_32(&asset->refcount);
+        }
+        taa_SPINLOCK_UNLOCK(&mgr->lock);
+    }
+    if(refcount == 0)
     {
-        int needfree = 0;
         taa_SPINLOCK_LOCK(&mgr->lock);
         if(asset->refcount == 0)
         {
@@ -305,17 +490,12 @@ void tgaasset_release(
             }
             else
             {
-                asset->mapval->asset = NULL;
-                needfree = 1;
+                // return overflow instance for reuse
+                tgaasset_detach(mgr, asset);
+                asset->next = mgr->overflow;
+                mgr->overflow = asset;
             }
         }
         taa_SPINLOCK_UNLOCK(&mgr->lock);
-        // don't call system functions while locked
-        if(needfree)
-        {
-            // free overflow instance
-            tgaasset_destroy(asset);
-            free(asset);
-        }
     }
 }
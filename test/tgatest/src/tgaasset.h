@@ -2,7 +2,7 @@
 #define TGAASSET_H_
 
 #include <taa/gl.h>
-#include <taa/asset.h>
+#include <taa/assetdir.h>
 
 typedef struct tgaasset_s tgaasset;
 typedef struct tgaasset_mgr_s tgaasset_mgr;
@@ -11,6 +11,12 @@ tgaasset* tgaasset_acquire(
     tgaasset_mgr* mgr,
     const taa_asset_key key);
 
+void tgaasset_change_file(
+    taa_asset_group* group,
+    taa_asset_file* file,
+    taa_asset_dir_change change,
+    void* userdata);
+
 void tgaasset_create_mgr(
     taa_asset_storage* storage,
     taa_workqueue* wq,
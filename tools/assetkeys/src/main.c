@@ -0,0 +1,294 @@
+#include <taa/assetdir.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    // the longest identifier written to the header
+    KEYS_MAX_IDENT = 256
+};
+
+typedef struct keys_entry_s keys_entry;
+
+// a key constant to be written to the header
+struct keys_entry_s
+{
+    char ident[KEYS_MAX_IDENT];
+    const char* name;
+    uint32_t key;
+};
+
+//****************************************************************************
+// orders entries by identifier
+static int keys_compare(
+    const void* a,
+    const void* b)
+{
+    const keys_entry* ea = (const keys_entry*) a;
+    const keys_entry* eb = (const keys_entry*) b;
+    return strcmp(ea->ident, eb->ident);
+}
+
+//****************************************************************************
+// orders entries by key
+static int keys_compare_key(
+    const void* a,
+    const void* b)
+{
+    const keys_entry* ea = (const keys_entry*) a;
+    const keys_entry* eb = (const keys_entry*) b;
+    return (ea->key < eb->key) ? -1 : ((ea->key > eb->key) ? 1 : 0);
+}
+
+//****************************************************************************
+// forms an identifier from a prefix and a range of a name. letters are
+// converted to upper case, and anything that is not a letter or digit is
+// replaced with an underscore.
+static void keys_make_ident(
+    const char* prefix,
+    const char* name,
+    size_t len,
+    char* ident)
+{
+    size_t n = strlen(prefix);
+    size_t i;
+    if(n + len >= KEYS_MAX_IDENT)
+    {
+        len = KEYS_MAX_IDENT - n - 1;
+    }
+    memcpy(ident, prefix, n);
+    for(i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char) name[i];
+        ident[n + i] = (char) (isalnum(c) ? toupper(c) : '_');
+    }
+    ident[n + len] = '\0';
+}
+
+//****************************************************************************
+// sorts entries by identifier and removes those that repeat the previous
+// entry. returns the number of entries that remain, or 0 if two different
+// names have the same identifier or the same key.
+static uint32_t keys_unique(
+    keys_entry* entries,
+    uint32_t n,
+    const char* kind)
+{
+    uint32_t count = 0;
+    uint32_t i;
+    int err = 0;
+    qsort(entries, n, sizeof(*entries), keys_compare);
+    for(i = 0; i < n; ++i)
+    {
+        if(count == 0 || strcmp(entries[count-1].ident, entries[i].ident))
+        {
+            entries[count++] = entries[i];
+        }
+        else if(entries[count - 1].key != entries[i].key)
+        {
+            fprintf(
+                stderr,
+                "error: %s and %s both have the identifier %s\n",
+                entries[count - 1].name,
+                entries[i].name,
+                entries[i].ident);
+            err = 1;
+        }
+    }
+    // a collision would give two constants the same value
+    qsort(entries, count, sizeof(*entries), keys_compare_key);
+    for(i = 1; i < count; ++i)
+    {
+        if(entries[i - 1].key == entries[i].key)
+        {
+            fprintf(
+                stderr,
+                "error: %s keys of %s and %s collide\n",
+                kind,
+                entries[i - 1].name,
+                entries[i].name);
+            err = 1;
+        }
+    }
+    qsort(entries, count, sizeof(*entries), keys_compare);
+    return err ? 0 : count;
+}
+
+//****************************************************************************
+// writes a block of key constants
+static int keys_write_entries(
+    FILE* fp,
+    const char* comment,
+    const keys_entry* entries,
+    uint32_t n)
+{
+    uint32_t i;
+    int err = fprintf(fp, "\n// %s\n", comment) < 0;
+    for(i = 0; !err && i < n; ++i)
+    {
+        err = fprintf(
+            fp,
+            "#define %s 0x%08xU\n",
+            entries[i].ident,
+            entries[i].key) < 0;
+    }
+    return err;
+}
+
+//****************************************************************************
+// writes a header of the group key and the file and type keys of every file
+// in a group
+static int keys_write(
+    const char* headerpath,
+    const char* prefix,
+    const char* dirpath,
+    const taa_asset_group* group)
+{
+    uint32_t n = group->numfiles;
+    keys_entry* files = (keys_entry*) malloc(n * sizeof(*files));
+    keys_entry* types = (keys_entry*) malloc(n * sizeof(*types));
+    char fileprefix[KEYS_MAX_IDENT];
+    char typeprefix[KEYS_MAX_IDENT];
+    char guard[KEYS_MAX_IDENT];
+    uint32_t numfiles;
+    uint32_t numtypes = 0;
+    uint32_t i;
+    FILE* fp = NULL;
+    int err;
+    keys_make_ident(prefix, "FILE_", 5, fileprefix);
+    keys_make_ident(prefix, "TYPE_", 5, typeprefix);
+    for(i = 0; i < n; ++i)
+    {
+        const char* name = group->files[i].name;
+        const char* ext = strrchr(name, '.');
+        keys_make_ident(
+            fileprefix,
+            name,
+            strcspn(name, "."),
+            files[i].ident);
+        files[i].name = name;
+        files[i].key = group->files[i].filekey;
+        // files without an extension have no type
+        if(ext != NULL)
+        {
+            keys_make_ident(
+                typeprefix,
+                ext + 1,
+                strlen(ext + 1),
+                types[numtypes].ident);
+            types[numtypes].name = name;
+            types[numtypes].key = group->files[i].typekey;
+            ++numtypes;
+        }
+    }
+    numfiles = keys_unique(files, n, "file");
+    if(numtypes > 0)
+    {
+        numtypes = keys_unique(types, numtypes, "type");
+        err = (numfiles == 0 || numtypes == 0);
+    }
+    else
+    {
+        err = (numfiles == 0);
+    }
+    if(!err)
+    {
+        fp = fopen(headerpath, "w");
+        err = (fp == NULL);
+    }
+    if(!err)
+    {
+        keys_make_ident(prefix, "KEYS_H_", 7, guard);
+        err |= fprintf(
+            fp,
+            "// generated by assetkeys from %s. do not edit.\n"
+            "#ifndef %s\n"
+            "#define %s\n"
+            "\n"
+            "#define %sGROUP 0x%08xU\n",
+            dirpath,
+            guard,
+            guard,
+            prefix,
+            group->key) < 0;
+        err |= keys_write_entries(fp, "file keys", files, numfiles);
+        err |= keys_write_entries(fp, "type keys", types, numtypes);
+        err |= fprintf(fp, "\n#endif // %s\n", guard) < 0;
+        err |= fclose(fp) != 0;
+        if(err)
+        {
+            // do not leave a partial header behind
+            remove(headerpath);
+        }
+    }
+    if(!err)
+    {
+        printf(
+            "wrote %u file keys and %u type keys to %s\n",
+            numfiles,
+            numtypes,
+            headerpath);
+    }
+    free(types);
+    free(files);
+    return err;
+}
+
+int main(int argc, char* argv[])
+{
+    taa_asset_dir_storage* dirmgr;
+    taa_asset_group* group;
+    char groupident[KEYS_MAX_IDENT];
+    char prefix[KEYS_MAX_IDENT];
+    const char* userprefix = NULL;
+    int argi = 1;
+    int err = 0;
+    while(!err && argi < argc && argv[argi][0] == '-')
+    {
+        const char* opt = argv[argi++];
+        if(!strcmp(opt, "-p") && argi < argc)
+        {
+            userprefix = argv[argi++];
+        }
+        else
+        {
+            err = 1;
+        }
+    }
+    if(err || argc - argi != 3)
+    {
+        fprintf(
+            stderr,
+            "usage: %s [-p prefix] <header> <group> <dir>\n"
+            "  -p  prefix of the constants (default is the group name)\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+    // constants are named <prefix>_GROUP, <prefix>_FILE_<name> and
+    // <prefix>_TYPE_<extension>
+    if(userprefix == NULL)
+    {
+        userprefix = argv[argi + 1];
+    }
+    keys_make_ident("", userprefix, strlen(userprefix), groupident);
+    keys_make_ident(groupident, "_", 1, prefix);
+    taa_asset_create_dir_storage(
+        1 << 20,
+        taa_ASSETDIR_DEFAULT_MAX_FDS,
+        0,
+        &dirmgr);
+    group = taa_asset_scan_dir(dirmgr, argv[argi + 1], argv[argi + 2]);
+    if(group != NULL)
+    {
+        err = keys_write(argv[argi], prefix, argv[argi + 2], group);
+    }
+    else
+    {
+        fprintf(stderr, "error: no files found in %s\n", argv[argi + 2]);
+        err = 1;
+    }
+    taa_asset_destroy_dir_storage(dirmgr);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
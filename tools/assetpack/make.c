@@ -0,0 +1,19 @@
+#include "src/main.c"
+
+#include "../../src/asset.c"
+#include "../../src/assetcache.c"
+#include "../../src/assetdir.c"
+#include "../../src/assetlz.c"
+#include "../../src/assetmap.c"
+#include "../../src/assetpack.c"
+#include "../../src/assetstorage.c"
+
+#include "../../../taasdk/src/conditionvar.c"
+#include "../../../taasdk/src/log.c"
+#include "../../../taasdk/src/mutex.c"
+#include "../../../taasdk/src/path.c"
+#include "../../../taasdk/src/semaphore.c"
+#include "../../../taasdk/src/system.c"
+#include "../../../taasdk/src/thread.c"
+#include "../../../taasdk/src/timer.c"
+#include "../../../taasdk/src/workqueue.c"
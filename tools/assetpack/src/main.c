@@ -0,0 +1,317 @@
+#include <taa/assetdir.h>
+#include <taa/assetlz.h>
+#include <taa/assetpack.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct pack_options_s pack_options;
+
+struct pack_options_s
+{
+    uint32_t alignment;
+    uint32_t blocksize;
+    int compress;
+};
+
+//****************************************************************************
+// orders files by type key and then by file key
+static int pack_compare(
+    const void* a,
+    const void* b)
+{
+    const taa_asset_file* fa = *((const taa_asset_file* const*) a);
+    const taa_asset_file* fb = *((const taa_asset_file* const*) b);
+    int result = 0;
+    if(fa->typekey != fb->typekey)
+    {
+        result = (fa->typekey < fb->typekey) ? -1 : 1;
+    }
+    else if(fa->filekey != fb->filekey)
+    {
+        result = (fa->filekey < fb->filekey) ? -1 : 1;
+    }
+    return result;
+}
+
+//****************************************************************************
+// writes zeros until the file position reaches the specified offset
+static int pack_pad(
+    FILE* fp,
+    uint64_t pos,
+    uint64_t offset)
+{
+    int err = 0;
+    while(!err && pos < offset)
+    {
+        err = fputc(0, fp) == EOF;
+        ++pos;
+    }
+    return err;
+}
+
+//****************************************************************************
+// compresses a file into independent blocks preceded by the block table.
+// returns the stored size, or 0 if compression does not reduce the size.
+static uint32_t pack_compress(
+    const unsigned char* src,
+    uint32_t size,
+    uint32_t blocksize,
+    unsigned char* dst)
+{
+    uint32_t numblocks = (size + blocksize - 1) / blocksize;
+    uint32_t tablesize = numblocks * sizeof(uint32_t);
+    uint32_t storedsize = tablesize;
+    uint32_t i;
+    for(i = 0; i < numblocks && storedsize < size; ++i)
+    {
+        uint32_t offset = i * blocksize;
+        uint32_t n = size - offset;
+        uint32_t c;
+        if(n > blocksize)
+        {
+            n = blocksize;
+        }
+        // blocks that do not shrink are stored as is
+        c = taa_asset_lz_compress(src + offset, n, dst + storedsize, n - 1);
+        if(c == 0)
+        {
+            memcpy(dst + storedsize, src + offset, n);
+            c = n | taa_ASSETPACK_BLOCK_STORED;
+        }
+        memcpy(dst + i*sizeof(uint32_t), &c, sizeof(c));
+        storedsize += c & ~taa_ASSETPACK_BLOCK_STORED;
+    }
+    return (storedsize < size) ? storedsize : 0;
+}
+
+//****************************************************************************
+// appends the contents of a source file to the pack and fills in the stored
+// size and flags of its entry
+static int pack_store(
+    FILE* fp,
+    const taa_asset_file* file,
+    const pack_options* options,
+    taa_asset_pack_entry* entry)
+{
+    FILE* src = fopen((const char*) file->handle, "rb");
+    uint32_t size = file->size;
+    unsigned char* data = (unsigned char*) malloc(size + 1);
+    unsigned char* stored = NULL;
+    uint32_t storedsize = 0;
+    int err = (src == NULL);
+    if(!err)
+    {
+        err = fread(data, 1, size, src) != size;
+        fclose(src);
+    }
+    if(!err && options->compress && size > 0)
+    {
+        uint32_t blocksize = options->blocksize;
+        uint32_t numblocks = (size + blocksize - 1) / blocksize;
+        stored = (unsigned char*) malloc(
+            numblocks * sizeof(uint32_t) +
+            numblocks * taa_asset_lz_bound(blocksize));
+        storedsize = pack_compress(data, size, blocksize, stored);
+    }
+    if(err)
+    {
+        fprintf(stderr, "error: could not read %s\n", (char*) file->handle);
+    }
+    else if(storedsize > 0)
+    {
+        entry->storedsize = storedsize;
+        entry->flags = taa_ASSETPACK_ENTRY_COMPRESSED;
+        err = fwrite(stored, 1, storedsize, fp) != storedsize;
+    }
+    else
+    {
+        entry->storedsize = size;
+        entry->flags = 0;
+        err = fwrite(data, 1, size, fp) != size;
+    }
+    free(stored);
+    free(data);
+    return err;
+}
+
+//****************************************************************************
+// writes every file in a group to a pack with its table of contents sorted
+// by type key and file key
+static int pack_write(
+    const char* packpath,
+    const taa_asset_group* group,
+    const pack_options* options)
+{
+    uint32_t n = group->numfiles;
+    uint64_t alignmask = options->alignment - 1;
+    const taa_asset_file** sorted;
+    taa_asset_pack_entry* entries;
+    taa_asset_pack_header header;
+    uint64_t pos;
+    uint64_t totalsize = 0;
+    uint64_t totalstored = 0;
+    uint32_t i;
+    FILE* fp;
+    int err = 0;
+    sorted = (const taa_asset_file**) malloc(n * sizeof(*sorted));
+    entries = (taa_asset_pack_entry*) calloc(n, sizeof(*entries));
+    for(i = 0; i < n; ++i)
+    {
+        sorted[i] = group->files + i;
+    }
+    qsort(sorted, n, sizeof(*sorted), pack_compare);
+    // keys must be unique for files to be found in the pack
+    for(i = 1; i < n; ++i)
+    {
+        if(pack_compare(sorted + i - 1, sorted + i) == 0)
+        {
+            fprintf(
+                stderr,
+                "error: %s and %s have the same key\n",
+                sorted[i - 1]->name,
+                sorted[i]->name);
+            err = 1;
+        }
+    }
+    // lay out the table of contents and the names. the data offsets are
+    // filled in as the files are written.
+    memset(&header, 0, sizeof(header));
+    header.magic = taa_ASSETPACK_MAGIC;
+    header.version = taa_ASSETPACK_VERSION;
+    header.numentries = n;
+    header.alignment = options->alignment;
+    header.blocksize = options->blocksize;
+    for(i = 0; i < n; ++i)
+    {
+        entries[i].typekey = sorted[i]->typekey;
+        entries[i].filekey = sorted[i]->filekey;
+        entries[i].nameoffset = header.namessize;
+        entries[i].size = sorted[i]->size;
+        header.namessize += strlen(sorted[i]->name) + 1;
+    }
+    pos = sizeof(header) + n*sizeof(*entries) + header.namessize;
+    header.dataoffset = (pos + alignmask) & ~alignmask;
+    fp = NULL;
+    if(!err)
+    {
+        fp = fopen(packpath, "wb");
+        err = (fp == NULL);
+    }
+    if(!err)
+    {
+        err |= fwrite(&header, sizeof(header), 1, fp) != 1;
+        err |= fwrite(entries, sizeof(*entries), n, fp) != n;
+        for(i = 0; !err && i < n; ++i)
+        {
+            uint32_t len = strlen(sorted[i]->name) + 1;
+            err |= fwrite(sorted[i]->name, 1, len, fp) != len;
+        }
+        for(i = 0; !err && i < n; ++i)
+        {
+            entries[i].offset = (pos + alignmask) & ~alignmask;
+            err |= pack_pad(fp, pos, entries[i].offset);
+            err |= pack_store(fp, sorted[i], options, entries + i);
+            pos = entries[i].offset + entries[i].storedsize;
+            totalsize += entries[i].size;
+            totalstored += entries[i].storedsize;
+        }
+        // rewrite the table of contents now that the offsets are known
+        err |= fseek(fp, 0, SEEK_SET) != 0;
+        err |= fwrite(&header, sizeof(header), 1, fp) != 1;
+        err |= fwrite(entries, sizeof(*entries), n, fp) != n;
+    }
+    if(fp != NULL)
+    {
+        err |= fclose(fp) != 0;
+        if(err)
+        {
+            // do not leave a partial pack behind
+            remove(packpath);
+        }
+    }
+    if(!err)
+    {
+        printf(
+            "packed %u files into %s: %llu bytes stored as %llu\n",
+            n,
+            packpath,
+            (unsigned long long) totalsize,
+            (unsigned long long) totalstored);
+    }
+    free(entries);
+    free(sorted);
+    return err;
+}
+
+//****************************************************************************
+// returns true if the value is a nonzero power of two
+static int pack_is_pow2(
+    uint32_t v)
+{
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    taa_asset_dir_storage* dirmgr;
+    taa_asset_group* group;
+    pack_options options;
+    int argi = 1;
+    int err = 0;
+    options.alignment = taa_ASSETPACK_DEFAULT_ALIGNMENT;
+    options.blocksize = taa_ASSETPACK_DEFAULT_BLOCK_SIZE;
+    options.compress = 0;
+    while(!err && argi < argc && argv[argi][0] == '-')
+    {
+        const char* opt = argv[argi++];
+        if(!strcmp(opt, "-c"))
+        {
+            options.compress = 1;
+        }
+        else if(!strcmp(opt, "-a") && argi < argc)
+        {
+            options.alignment = (uint32_t) strtoul(argv[argi++], NULL, 0);
+            err = !pack_is_pow2(options.alignment);
+        }
+        else if(!strcmp(opt, "-b") && argi < argc)
+        {
+            options.blocksize = (uint32_t) strtoul(argv[argi++], NULL, 0);
+            err = !pack_is_pow2(options.blocksize);
+        }
+        else
+        {
+            err = 1;
+        }
+    }
+    if(err || argc - argi != 2)
+    {
+        fprintf(
+            stderr,
+            "usage: %s [-c] [-a alignment] [-b blocksize] <pack> <dir>\n"
+            "  -c  compress files in blocks\n"
+            "  -a  alignment of file data, a power of two (default %u)\n"
+            "  -b  uncompressed block size, a power of two (default %u)\n",
+            argv[0],
+            taa_ASSETPACK_DEFAULT_ALIGNMENT,
+            taa_ASSETPACK_DEFAULT_BLOCK_SIZE);
+        return EXIT_FAILURE;
+    }
+    taa_asset_create_dir_storage(
+        1 << 20,
+        taa_ASSETDIR_DEFAULT_MAX_FDS,
+        0,
+        &dirmgr);
+    group = taa_asset_scan_dir(dirmgr, "pack", argv[argi + 1]);
+    if(group != NULL)
+    {
+        err = pack_write(argv[argi], group, &options);
+    }
+    else
+    {
+        fprintf(stderr, "error: no files found in %s\n", argv[argi + 1]);
+        err = 1;
+    }
+    taa_asset_destroy_dir_storage(dirmgr);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}